@@ -0,0 +1,52 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <nesdev/core.h>
+#include "benchmark.h"
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+static constexpr std::size_t kBoots = 20;
+
+NESDEV_CORE_BENCHMARK(CachedBoot) {
+  core::BootCache cache(std::filesystem::temp_directory_path().string());
+  for (auto rom : {"sample1.nes", "nestest.nes"}) {
+    const std::string path = state.Data(rom);
+    // Up to the first frame after the boot, i.e., the first one to take input.
+    auto boot = [&cache, &path]() {
+      auto nes = Boot(path);
+      nes->SkipOutput(true);
+      const bool hit = cache.Boot(nes.get());
+      RunFrame(*nes);
+      return hit;
+    };
+    const std::string file = cache.PathOf(Boot(path)->rom->Hash());
+    std::filesystem::remove(file);
+    state.Measure(std::string(rom) + " booted", kBoots, "boots", [&cache, &file, &boot]() {
+      for (std::size_t i = 0; i < kBoots; i++) {
+        boot();
+        cache.Flush();
+        std::filesystem::remove(file);
+      }
+    });
+    boot();
+    cache.Flush();
+    state.Measure(std::string(rom) + " restored from cache", kBoots, "boots", [&boot]() {
+      for (std::size_t i = 0; i < kBoots; i++) boot();
+    });
+    std::filesystem::remove(file);
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
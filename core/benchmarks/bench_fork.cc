@@ -0,0 +1,40 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <nesdev/core.h>
+#include "benchmark.h"
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+static constexpr std::size_t kForks = 2000;
+
+NESDEV_CORE_BENCHMARK(Fork) {
+  for (auto rom : {"sample1.nes", "nestest.nes"}) {
+    auto nes = Boot(state.Data(rom));
+    nes->SkipOutput(true);
+    for (std::size_t frame = 0; frame < 60; frame++) RunFrame(*nes);
+
+    const double throughput = state.Measure(std::string(rom) + " forked", kForks, "forks", [&nes]() {
+      for (std::size_t i = 0; i < kForks; i++) {
+        auto fork = nes->Fork();
+      }
+    });
+    std::printf("  %-40s %12.2f us/fork\n", "fork cost", 1e6 / throughput);
+    // Branches as searches do, i.e., runs a frame off each fork.
+    state.Measure(std::string(rom) + " forked and run a frame", kForks / 10, "forks", [&nes]() {
+      for (std::size_t i = 0; i < kForks / 10; i++) nes->Fork()->RunFrame();
+    });
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
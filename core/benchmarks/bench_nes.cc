@@ -0,0 +1,43 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <nesdev/core.h>
+#include "detail/static_nes.h"
+#include "benchmark.h"
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+static constexpr std::size_t kFrames = 600;
+
+template <typename T>
+static double MeasureFrames(State& state, const std::string& rom, const std::string& label) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH);
+  auto nes = Boot<T>(state.Data(rom));
+  nes->ppu->Framebuffer([&framebuffer](std::int16_t x, std::int16_t y, ARGB argb) {
+    framebuffer[y * PPU::kFrameW + x] = argb;
+  });
+  for (std::size_t frame = 0; frame < 60; frame++) RunFrame(*nes);
+  return state.Measure(rom + " " + label, kFrames, "frames", [&nes]() {
+    for (std::size_t frame = 0; frame < kFrames; frame++) RunFrame(*nes);
+  });
+}
+
+NESDEV_CORE_BENCHMARK(NESComposition) {
+  for (auto rom : {"sample1.nes", "nestest.nes"}) {
+    auto virtuals = MeasureFrames<NES>(state, rom, "virtual");
+    auto statics  = MeasureFrames<detail::StaticNES>(state, rom, "static");
+    std::printf("  %-40s %12.2fx\n", "speedup", virtuals > 0.0 ? statics / virtuals : 0.0);
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
@@ -0,0 +1,67 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <nesdev/core.h>
+#include "benchmark.h"
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+static constexpr std::size_t kFrames = 300;
+
+static constexpr std::size_t kWindow = 8;
+
+/*
+ * Buttons changing every few frames, the way players press them, so that predictions fail as
+ * often as they would in play.
+ */
+static Byte Buttons(std::size_t player, std::size_t frame) {
+  std::size_t held = (frame + player * 3) / 5;
+  held = held * 2654435761u + player;
+  return static_cast<Byte>(held >> 13);
+}
+
+/*
+ * Both sides run on the host every tick, each within the budget of a frame on its own host.
+ */
+NESDEV_CORE_BENCHMARK(Netplay) {
+  for (auto rom : {"sample1.nes", "nestest.nes"}) {
+    for (std::size_t delay : {0, 2, 4, 7}) {
+      Loopback loopback(delay);
+      std::vector<std::unique_ptr<NES>> nes;
+      std::vector<Rollback> sessions;
+      for (std::size_t player = 0; player < 2; player++) {
+        nes.push_back(Boot(state.Data(rom)));
+        nes.back()->ppu->Framebuffer([](std::int16_t, std::int16_t, ARGB) {});
+        for (std::size_t frame = 0; frame < 60; frame++) RunFrame(*nes.back());
+        sessions.emplace_back(loopback.End(player), player, kWindow);
+      }
+
+      const double throughput = state.Measure(std::string(rom) + " " + std::to_string(delay) + " frames of delay", kFrames, "ticks", [&]() {
+        for (std::size_t tick = 0; tick < kFrames; tick++) {
+          for (std::size_t player = 0; player < 2; player++) {
+            const auto frame = sessions[player].Frames();
+            sessions[player].RunFrame(nes[player].get(), Buttons(player, frame));
+          }
+          loopback.Tick();
+        }
+      });
+      const auto& session = sessions[0];
+      std::printf("  %-40s %12.2f frames/rollback\n", "re-simulated", session.Rollbacks() == 0 ? 0.0 : static_cast<double>(session.Resimulated()) / session.Rollbacks());
+      std::printf("  %-40s %12.2f us/frame\n", "budget left per side", 1e6 / 60.0 - 1e6 / throughput / 2);
+    }
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
@@ -0,0 +1,43 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <nesdev/core.h>
+#include "benchmark.h"
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+static constexpr std::size_t kRestarts = 2000;
+
+NESDEV_CORE_BENCHMARK(PowerCycle) {
+  for (auto rom : {"sample1.nes", "nestest.nes"}) {
+    const std::string path = state.Data(rom);
+    state.Measure(std::string(rom) + " constructed", kRestarts, "restarts", [&path]() {
+      for (std::size_t i = 0; i < kRestarts; i++) {
+        auto nes = Boot(path);
+      }
+    });
+    auto nes = Boot(path);
+    nes->SkipOutput(true);
+    RunFrame(*nes);
+    state.Measure(std::string(rom) + " power-cycled", kRestarts, "restarts", [&nes]() {
+      for (std::size_t i = 0; i < kRestarts; i++) nes->PowerCycle();
+    });
+    std::ifstream ifs(path, std::ifstream::binary);
+    const auto cartridge = ROMFactory::NROM(ifs);
+    state.Measure(std::string(rom) + " cartridge loaded", kRestarts, "restarts", [&nes, &cartridge]() {
+      for (std::size_t i = 0; i < kRestarts; i++) nes->LoadCartridge(*cartridge);
+    });
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
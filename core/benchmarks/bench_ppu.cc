@@ -0,0 +1,41 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <nesdev/core.h>
+#include "benchmark.h"
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+static constexpr std::size_t kFrames = 600;
+
+NESDEV_CORE_BENCHMARK(PPUSkipOutput) {
+  for (auto rom : {"sample1.nes", "nestest.nes"}) {
+    std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH);
+    auto nes = Boot(state.Data(rom));
+    nes->ppu->Framebuffer([&framebuffer](std::int16_t x, std::int16_t y, ARGB argb) {
+      framebuffer[y * PPU::kFrameW + x] = argb;
+    });
+    for (std::size_t frame = 0; frame < 60; frame++) RunFrame(*nes);
+
+    auto composed = state.Measure(std::string(rom) + " composed", kFrames, "frames", [&nes]() {
+      for (std::size_t frame = 0; frame < kFrames; frame++) RunFrame(*nes);
+    });
+    nes->SkipOutput(true);
+    auto skipped = state.Measure(std::string(rom) + " skipped", kFrames, "frames", [&nes]() {
+      for (std::size_t frame = 0; frame < kFrames; frame++) RunFrame(*nes);
+    });
+    std::printf("  %-40s %12.2fx\n", "speedup", composed > 0.0 ? skipped / composed : 0.0);
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
@@ -0,0 +1,58 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <nesdev/core.h>
+#include "benchmark.h"
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+static constexpr std::size_t kFrames = 600;
+
+static constexpr std::size_t kBudget = 16 << 20;
+
+NESDEV_CORE_BENCHMARK(RewindCapture) {
+  for (auto rom : {"sample1.nes", "nestest.nes"}) {
+    std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH);
+    auto nes = Boot(state.Data(rom));
+    nes->ppu->Framebuffer([&framebuffer](std::int16_t x, std::int16_t y, ARGB argb) {
+      framebuffer[y * PPU::kFrameW + x] = argb;
+    });
+    for (std::size_t frame = 0; frame < 60; frame++) RunFrame(*nes);
+
+    for (std::size_t interval : {1, 4}) {
+      Rewind rewind(kBudget, interval);
+      // Captures are timed apart from frames, whose own timing varies far more than they take.
+      std::chrono::duration<double, std::micro> elapsed(0);
+      state.Measure(std::string(rom) + " captured every " + std::to_string(interval), kFrames, "frames", [&nes, &rewind, &elapsed]() {
+        for (std::size_t frame = 0; frame < kFrames; frame++) {
+          const auto start = std::chrono::steady_clock::now();
+          rewind.Capture(nes.get());
+          elapsed += std::chrono::steady_clock::now() - start;
+          RunFrame(*nes);
+        }
+      });
+      const double per_snapshot = static_cast<double>(rewind.Usage()) / rewind.Count();
+      std::printf("  %-40s %12.2f us/frame\n", "capture cost", elapsed.count() / kFrames);
+      std::printf("  %-40s %12.2f bytes (raw %zu)\n", "snapshot", per_snapshot, nes->StateSize());
+      std::printf("  %-40s %12.2f s at 60 fps\n", "history in 16MB", kBudget / per_snapshot * interval / 60.0);
+      const std::size_t count = rewind.Count();
+      state.Measure(std::string(rom) + " stepped back", count, "snapshots", [&nes, &rewind]() {
+        while (rewind.Step(nes.get()));
+      });
+    }
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
@@ -0,0 +1,42 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <nesdev/core.h>
+#include "benchmark.h"
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+static constexpr std::size_t kFrames = 600;
+
+NESDEV_CORE_BENCHMARK(RunAhead) {
+  for (auto rom : {"sample1.nes", "nestest.nes"}) {
+    std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH);
+    auto nes = Boot(state.Data(rom));
+    nes->ppu->Framebuffer([&framebuffer](std::int16_t x, std::int16_t y, ARGB argb) {
+      framebuffer[y * PPU::kFrameW + x] = argb;
+    });
+    for (std::size_t frame = 0; frame < 60; frame++) RunFrame(*nes);
+
+    double baseline = 0.0;
+    for (std::size_t ahead : {0, 1, 2}) {
+      const double throughput = state.Measure(std::string(rom) + " " + std::to_string(ahead) + " frames ahead", kFrames, "frames", [&nes, ahead]() {
+        for (std::size_t frame = 0; frame < kFrames; frame++) nes->RunFrameAhead(ahead);
+      });
+      if (ahead == 0) baseline = throughput;
+      else std::printf("  %-40s %12.2f us/frame\n", "added cost", 1e6 / throughput - 1e6 / baseline);
+    }
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
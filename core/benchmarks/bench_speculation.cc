@@ -0,0 +1,45 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <nesdev/core.h>
+#include "benchmark.h"
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+static constexpr std::size_t kFrames = 120;
+
+/*
+ * The same frames run serially and with the PPU speculated on a worker thread.
+ */
+NESDEV_CORE_BENCHMARK(Speculation) {
+  for (auto rom : {"sample1.nes", "nestest.nes"}) {
+    for (bool speculate : {false, true}) {
+      auto nes = Boot(state.Data(rom));
+      nes->ppu->Framebuffer([](std::int16_t, std::int16_t, ARGB) {});
+      for (std::size_t frame = 0; frame < 60; frame++) RunFrame(*nes);
+      nes->Speculate(speculate);
+
+      state.Measure(std::string(rom) + (speculate ? " speculative" : " serial"), kFrames, "frames", [&]() {
+        for (std::size_t frame = 0; frame < kFrames; frame++) RunFrame(*nes);
+      });
+      if (!speculate) continue;
+      const auto& counters = nes->Speculation();
+      std::printf("  %-40s %12.2f /frame\n", "writes deferred", static_cast<double>(counters.writes) / kFrames);
+      std::printf("  %-40s %12.2f /frame\n", "synchronizations", static_cast<double>(counters.synchronizations) / kFrames);
+      std::printf("  %-40s %12.2f /frame\n", "conflicts", static_cast<double>(counters.conflicts) / kFrames);
+      std::printf("  %-40s %12.2f /frame\n", "rollbacks", static_cast<double>(counters.rollbacks) / kFrames);
+    }
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
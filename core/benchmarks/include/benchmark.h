@@ -0,0 +1,94 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#ifndef _NESDEV_CORE_BENCHMARKS_BENCHMARK_H_
+#define _NESDEV_CORE_BENCHMARKS_BENCHMARK_H_
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nesdev/core.h>
+
+namespace nesdev {
+namespace core {
+namespace benchmarks {
+
+class State {
+ public:
+  explicit State(std::string data)
+    : data_{std::move(data)} {}
+
+  [[nodiscard]]
+  std::string Data(const std::string& file) const {
+    return data_ + "/" + file;
+  }
+
+  /*
+   * Runs the given function once and reports how many items per second it has processed.
+   */
+  template <typename Function>
+  double Measure(const std::string& label, std::size_t items, const std::string& unit, Function&& function) {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const double throughput = elapsed.count() > 0.0 ? items / elapsed.count() : 0.0;
+    std::printf("  %-40s %12.2f %s/s (%zu %s in %.3f s)\n",
+                label.c_str(), throughput, unit.c_str(), items, unit.c_str(), elapsed.count());
+    return throughput;
+  }
+
+ private:
+  std::string data_;
+};
+
+struct Benchmark {
+  using Body = void (*)(State&);
+
+  static std::vector<Benchmark>& All() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+  }
+
+  static bool Register(const char* name, Body body) {
+    All().push_back({name, body});
+    return true;
+  }
+
+  const char* name;
+
+  Body body;
+};
+
+template <typename T = NES>
+std::unique_ptr<T> Boot(const std::string& rom) {
+  std::ifstream ifs(rom, std::ifstream::binary);
+  if (!ifs) NESDEV_CORE_THROW(InvalidROM::Occur("Failed to open " + rom));
+  return std::make_unique<T>(ROMFactory::NROM(ifs));
+}
+
+/*
+ * Runs the NES until the PPU enters the post-render line, i.e., until a frame completes.
+ */
+template <typename T>
+void RunFrame(T& nes) {
+  nes.RunFrame();
+}
+
+}  // namespace benchmarks
+}  // namespace core
+}  // namespace nesdev
+
+#define NESDEV_CORE_BENCHMARK(name)                                    \
+  static void name(nesdev::core::benchmarks::State&);                  \
+  [[maybe_unused]] static const bool name##_registered_ =              \
+    nesdev::core::benchmarks::Benchmark::Register(#name, name);        \
+  static void name(nesdev::core::benchmarks::State& state)
+
+#endif  // ifndef _NESDEV_CORE_BENCHMARKS_BENCHMARK_H_
@@ -0,0 +1,31 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstdio>
+#include <exception>
+#include <string>
+#include "benchmark.h"
+
+/*
+ * Usage: RunAllBenchmarks [filter] [data directory]
+ */
+int main(int argc, char **argv) {
+  namespace nb = nesdev::core::benchmarks;
+  const std::string filter = argc > 1 ? argv[1] : "";
+  nb::State state{argc > 2 ? argv[2] : "data"};
+  int status = 0;
+  for (auto& benchmark : nb::Benchmark::All()) {
+    if (std::string(benchmark.name).find(filter) == std::string::npos) continue;
+    std::printf("%s\n", benchmark.name);
+    try {
+      benchmark.body(state);
+    } catch (const std::exception& e) {
+      std::fprintf(stderr, "  failed: %s\n", e.what());
+      status = 1;
+    }
+  }
+  return status;
+}
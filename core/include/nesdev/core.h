@@ -9,21 +9,26 @@
 
 #include "core/macros.h"
 #include "core/apu.h"
+#include "core/boot_cache.h"
 #include "core/clock.h"
 #include "core/cpu.h"
 #include "core/cpu_factory.h"
 #include "core/exceptions.h"
 #include "core/memory_bank.h"
 #include "core/memory_bank_factory.h"
+#include "core/movie.h"
 #include "core/mmu.h"
 #include "core/mmu_factory.h"
 #include "core/nes.h"
+#include "core/netplay.h"
 #include "core/opcodes.h"
 #include "core/palettes.h"
 #include "core/ppu.h"
 #include "core/ppu_factory.h"
+#include "core/rewind.h"
 #include "core/rom.h"
 #include "core/rom_factory.h"
+#include "core/snapshot.h"
 #include "core/types.h"
 
 #endif  // ifndef _NESDEV_CORE_H_
@@ -0,0 +1,119 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#ifndef _NESDEV_CORE_BOOT_CACHE_H_
+#define _NESDEV_CORE_BOOT_CACHE_H_
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <string>
+#include "nesdev/core/exceptions.h"
+#include "nesdev/core/macros.h"
+#include "nesdev/core/snapshot.h"
+#include "nesdev/core/types.h"
+
+namespace nesdev {
+namespace core {
+
+/*
+ * Caches the state machines reach after booting for a given number of frames on the disk, keyed
+ * by the ROM hash, the revision of the emulation and the number of frames, so that machines of
+ * a cartridge booted once start right off the frame cached from then on. Cartridges backed up by
+ * battery bypass the cache, since how they boot depends on what they have saved.
+ *
+ * The revision must be bumped whenever the emulation changes what machines boot into.
+ */
+class BootCache final {
+ public:
+  static constexpr std::uint32_t kRevision = 1;
+
+ public:
+  /*
+   * Caches to the specified directory, which must exist, the state after the specified number of
+   * frames.
+   */
+  explicit BootCache(std::string directory, std::size_t frames = 120);
+
+  /*
+   * Power-cycles the specified NES, then brings it to the end of its boot frames, either restored
+   * from the cache, or run with no buttons pressed and cached on the way. No pixels are written
+   * during the boot either way. Returns true if the cache has hit.
+   */
+  template <typename NES>
+  bool Boot(NES* const nes) {
+    nes->PowerCycle();
+    const bool cacheable = !nes->rom->header->ContainsPersistentMemory();
+    const std::string path = PathOf(nes->rom->Hash());
+    const bool skip = nes->ppu->IsSkippingOutput();
+    nes->ppu->SkipOutput(true);
+    const bool hit = cacheable && Restore(path, nes);
+    if (!hit) {
+      nes->controller_1->Buttons(0x00);
+      nes->controller_2->Buttons(0x00);
+      for (std::size_t frame = 0; frame < frames_; frame++) nes->RunFrame();
+      if (cacheable) Store(path, nes);
+    }
+    nes->ppu->SkipOutput(skip);
+    return hit;
+  }
+
+  /*
+   * Waits until the snapshots cached so far get synced, rethrowing the errors on writing them.
+   */
+  void Flush();
+
+  [[nodiscard]]
+  std::string PathOf(std::uint64_t rom_hash) const;
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  /*
+   * Falls back to power-cycling on broken or stale files, which get overwritten once booted.
+   */
+  template <typename NES>
+  bool Restore(const std::string& path, NES* const nes) {
+    std::ifstream ifs(path, std::ifstream::binary);
+    if (!ifs) return false;
+    try {
+      Snapshot::Load(ifs, nes);
+      return true;
+    } catch (const InvalidOperation&) {
+      nes->PowerCycle();
+      return false;
+    }
+  }
+
+  /*
+   * Failing to write the cache costs nothing but booting next time too, hence never stops booting.
+   * The writer rethrows the errors of the files written before once written to again, which are
+   * kept to be rethrown by the next flush, the snapshot then queued all the same.
+   */
+  template <typename NES>
+  void Store(const std::string& path, NES* const nes) {
+    while (true) {
+      try {
+        writer_.Write(path, nes);
+        return;
+      } catch (const InvalidOperation&) {
+        if (!error_) error_ = std::current_exception();
+      }
+    }
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  const std::string directory_;
+
+  const std::size_t frames_;
+
+  SnapshotWriter writer_;
+
+  // The first error on writing the files cached, which the writer has rethrown to Store.
+  std::exception_ptr error_;
+};
+
+}  // namespace core
+}  // namespace nesdev
+#endif  // ifndef _NESDEV_CORE_BOOT_CACHE_H_
@@ -188,6 +188,29 @@ class CPU : public Clock {
     } pointer = {0x0000};
   };
 
+ public:
+  /*
+   * Plain-data image of the CPU, i.e., the registers, the context and the steps left of the
+   * instruction in flight, each of which is told by where it has been staged from.
+   */
+  struct State {
+    static constexpr std::size_t kMaxSteps = 32;
+
+    Registers registers;
+
+    Context context;
+
+    Byte status;
+
+    Byte num_steps;
+
+    Word steps[kMaxSteps];
+  };
+
+  virtual void Save(State* const state) const = 0;
+
+  virtual void Load(const State& state) = 0;
+
  NESDEV_CORE_PROTECTED_UNLESS_TESTED:
   void Addr(Address address) {
     context_.address.effective = address;
@@ -30,6 +30,15 @@ class MemoryBank {
   virtual Byte* Data() = 0;
 
   virtual const Byte* Data() const = 0;
+
+  /*
+   * Points to the 1KB page holding the specified address, so that hot paths may read it without
+   * going through the bus. Banks which do not keep such a page in place return nullptr.
+   */
+  [[nodiscard]]
+  virtual const Byte* PageAt(Address) const {
+    return nullptr;
+  }
 };
 
 using MemoryBanks = std::vector<std::unique_ptr<MemoryBank>>;
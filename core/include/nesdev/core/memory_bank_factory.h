@@ -7,6 +7,7 @@
 #ifndef _NESDEV_CORE_MEMORY_BANK_FACTORY_H_
 #define _NESDEV_CORE_MEMORY_BANK_FACTORY_H_
 #include <memory>
+#include <functional>
 #include "nesdev/core/memory_bank.h"
 #include "nesdev/core/nes.h"
 #include "nesdev/core/ppu.h"
@@ -22,7 +23,21 @@ class MemoryBankFactory {
                             PPU* const ppu,
                             NES::DirectMemoryAccess* const dma,
                             NES::Controller* const controller_1,
-            NES::Controller* const controller_2);
+                            NES::Controller* const controller_2,
+                            std::function<void()> synchronize = []() {});
+
+  /*
+   * Routes the accesses to the PPU registers to the specified reader and writer instead, e.g., so
+   * that writes may be deferred.
+   */
+  [[nodiscard]]
+  static MemoryBanks CPUBus(ROM* const rom,
+                            std::function<Byte(Address)> ppu_reader,
+                            std::function<void(Address, Byte)> ppu_writer,
+                            NES::DirectMemoryAccess* const dma,
+                            NES::Controller* const controller_1,
+                            NES::Controller* const controller_2,
+                            std::function<void()> synchronize = []() {});
 
   [[nodiscard]]
   static MemoryBanks PPUBus(ROM* const rom);
@@ -21,6 +21,16 @@ class MMU {
   virtual Byte Read(Address address) const = 0;
 
   virtual void Write(Address address, Byte byte) = 0;
+
+  [[nodiscard]]
+  virtual const Byte* PageAt(Address address) const = 0;
+
+  /*
+   * Returns the bank mapped at the specified address, e.g., to take snapshots of its contents,
+   * or nullptr if none is mapped.
+   */
+  [[nodiscard]]
+  virtual MemoryBank* BankAt(Address address) const = 0;
 };
 
 }  // namespace core
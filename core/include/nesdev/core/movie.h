@@ -0,0 +1,153 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#ifndef _NESDEV_CORE_MOVIE_H_
+#define _NESDEV_CORE_MOVIE_H_
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+#include "nesdev/core/exceptions.h"
+#include "nesdev/core/macros.h"
+#include "nesdev/core/nes.h"
+#include "nesdev/core/types.h"
+
+namespace nesdev {
+namespace core {
+
+/*
+ * Records the controller input frame by frame, along with the machine as it was when recording
+ * started, so that runs may be replayed frame-exactly. Since the emulation itself depends on
+ * nothing but the machine and the input, playback does not depend on timing nor on the host. Movies
+ * recorded from power-on carry no state at all, the machine getting power cycled on playback.
+ *
+ * The file format is as follows, the start state and the input compressed as snapshots are, the
+ * input being the buttons of controller 1 and 2 per frame. All the integers are little-endian.
+ *
+ * Header : "NESM", version (4 bytes), ROM hash (8 bytes), number of frames (4 bytes), flags (4 bytes),
+ *          state size (4 bytes), compressed state size (4 bytes), compressed input size (4 bytes)
+ * Flags  : bit 0 set if recorded from power-on, in which case the state is empty
+ */
+class Movie final {
+ public:
+  static constexpr std::uint32_t kVersion = 2;
+
+  static constexpr std::size_t kHeaderSize = 36;
+
+  static constexpr std::uint32_t kFromPowerOn = 0x00000001;
+
+ public:
+  /*
+   * Starts recording the specified NES from its current state, dropping whatever was recorded.
+   */
+  template <typename NES>
+  void Record(NES* const nes) {
+    rom_hash_      = nes->rom->Hash();
+    from_power_on_ = false;
+    start_.resize(nes->StateSize());
+    nes->SaveState(start_.data(), start_.size());
+    inputs_.clear();
+    position_ = 0;
+  }
+
+  /*
+   * Power cycles the specified NES, then starts recording it, dropping whatever was recorded.
+   */
+  template <typename NES>
+  void RecordFromPowerOn(NES* const nes) {
+    nes->PowerCycle();
+    rom_hash_      = nes->rom->Hash();
+    from_power_on_ = true;
+    start_.clear();
+    inputs_.clear();
+    position_ = 0;
+  }
+
+  /*
+   * Records the input as is, then runs a frame with it.
+   */
+  template <typename NES>
+  NESBase::Status RecordFrame(NES* const nes) {
+    inputs_.push_back(nes->controller_1->Buttons());
+    inputs_.push_back(nes->controller_2->Buttons());
+    return nes->RunFrame();
+  }
+
+  /*
+   * Restores the specified NES to the state recording started from, power cycling it if recorded
+   * from power-on. Throws if the NES has another cartridge inserted.
+   */
+  template <typename NES>
+  void Play(NES* const nes) {
+    if (nes->rom->Hash() != rom_hash_)
+      NESDEV_CORE_THROW(InvalidOperation::Occur("Movie of another cartridge specified to nesdev::core::Movie::Play"));
+    if (from_power_on_) nes->PowerCycle();
+    else nes->LoadState(start_.data(), start_.size());
+    position_ = 0;
+  }
+
+  /*
+   * Feeds the input of the next frame, then runs the frame. Returns false, running nothing, once
+   * the movie ends.
+   */
+  template <typename NES>
+  bool PlayFrame(NES* const nes) {
+    if (position_ >= Frames()) return false;
+    nes->controller_1->Buttons(inputs_[2 * position_]);
+    nes->controller_2->Buttons(inputs_[2 * position_ + 1]);
+    position_++;
+    nes->RunFrame();
+    return true;
+  }
+
+  void Save(std::ostream& os) const;
+
+  /*
+   * Replaces the movie with the one read off the specified stream. Throws if the file is of
+   * another version or corrupted.
+   */
+  void Load(std::istream& is);
+
+  [[nodiscard]]
+  std::size_t Frames() const {
+    return inputs_.size() / 2;
+  }
+
+  /*
+   * The number of frames played so far.
+   */
+  [[nodiscard]]
+  std::size_t Position() const {
+    return position_;
+  }
+
+  [[nodiscard]]
+  std::uint64_t ROMHash() const {
+    return rom_hash_;
+  }
+
+  [[nodiscard]]
+  bool FromPowerOn() const {
+    return from_power_on_;
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  std::uint64_t rom_hash_ = {0};
+
+  bool from_power_on_ = {false};
+
+  // The state recording started from, empty if from power-on.
+  std::vector<Byte> start_;
+
+  // The buttons of controller 1 and 2 per frame, interleaved.
+  std::vector<Byte> inputs_;
+
+  std::size_t position_ = {0};
+};
+
+}  // namespace core
+}  // namespace nesdev
+#endif  // ifndef _NESDEV_CORE_MOVIE_H_
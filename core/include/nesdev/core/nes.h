@@ -6,11 +6,18 @@
  */
 #ifndef _NESDEV_CORE_NES_H_
 #define _NESDEV_CORE_NES_H_
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory.h>
+#include <vector>
 #include "nesdev/core/clock.h"
 #include "nesdev/core/cpu.h"
+#include "nesdev/core/memory_bank.h"
 #include "nesdev/core/mmu.h"
 #include "nesdev/core/ppu.h"
 #include "nesdev/core/rom.h"
@@ -18,10 +25,52 @@
 
 namespace nesdev {
 namespace core {
+namespace detail {
+
+class PPUWorker;
+
+}  // namespace detail
+
+/*
+ * Holds the devices and types shared by every composition of BasicNES.
+ */
+class NESBase : public Clock {
+ public:
+  /*
+   * Hands over a section of a snapshot. Empty sections come with nullptr.
+   */
+  using StateWriter = std::function<void(const Byte*, std::size_t)>;
+
+  /*
+   * Fills a section of a snapshot with the specified number of bytes.
+   */
+  using StateReader = std::function<void(Byte*, std::size_t)>;
+
+ public:
+  /*
+   * Describes why execution has stopped.
+   */
+  enum class Status : Byte {
+    FRAME,
+    BREAKPOINT,
+    BUDGET
+  };
+
+  static constexpr std::size_t kUnlimited = std::numeric_limits<std::size_t>::max();
 
-class NES final : public Clock {
  public:
   class DirectMemoryAccess {
+   public:
+    struct State {
+      Address address;
+
+      Byte data;
+
+      bool transfer;
+
+      bool wait_for_even_cycle;
+    };
+
    public:
     Byte Read([[maybe_unused]] Address address) {
       return address_.page;
@@ -37,12 +86,13 @@ class NES final : public Clock {
       return transfer_;
     }
 
-    void TransactAt(std::size_t cycle, MMU* const bus, PPU::Chips* const chips) {
+    template <typename BusT, typename PpuT>
+    void TransactAt(std::size_t cycle, BusT* const bus, PpuT* const ppu) {
       if (IsWaiting()) {
         if (cycle % 2 == 1) Ready();
       } else {
         if (cycle % 2 == 0) Load(bus);
-        else Transfer(chips);
+        else Transfer(ppu);
       }
     }
 
@@ -53,6 +103,20 @@ class NES final : public Clock {
       wait_for_even_cycle_ = true;
     }
 
+    void Save(State* const state) const {
+      state->address             = address_.value;
+      state->data                = data_;
+      state->transfer            = transfer_;
+      state->wait_for_even_cycle = wait_for_even_cycle_;
+    }
+
+    void Load(const State& state) {
+      address_.value       = state.address;
+      data_                = state.data;
+      transfer_            = state.transfer;
+      wait_for_even_cycle_ = state.wait_for_even_cycle;
+    }
+
    NESDEV_CORE_PRIVATE_UNLESS_TESTED:
     bool IsWaiting() {
       return wait_for_even_cycle_;
@@ -62,12 +126,14 @@ class NES final : public Clock {
       wait_for_even_cycle_ = false;
     }
 
-    void Load(MMU* const bus) {
+    template <typename BusT>
+    void Load(BusT* const bus) {
       data_ = bus->Read(address_.value);
     }
 
-    void Transfer(PPU::Chips* const chips) {
-      chips->oam->Write(address_.offset++, data_);
+    template <typename PpuT>
+    void Transfer(PpuT* const ppu) {
+      ppu->WriteOAM(address_.offset++, data_);
       if (address_.offset == 0x00) {
         transfer_            = false;
         wait_for_even_cycle_ = true;
@@ -88,7 +154,45 @@ class NES final : public Clock {
     bool wait_for_even_cycle_ = true;
   };
 
+  /*
+   * Keeps the master clock timestamps, in dots, of the next interesting things to happen, so that
+   * the CPU and PPU may run in bulk until the earliest of them.
+   */
+  class Scheduler {
+   public:
+    enum class Event : Byte {
+      MAPPER,
+      VBLANK,
+      FRAME,
+      NUM_EVENTS
+    };
+
+    void Schedule(Event event, std::uint64_t timestamp) {
+      timestamps_[static_cast<std::size_t>(event)] = timestamp;
+    }
+
+    [[nodiscard]]
+    std::uint64_t At(Event event) const {
+      return timestamps_[static_cast<std::size_t>(event)];
+    }
+
+    [[nodiscard]]
+    std::uint64_t Next() const {
+      return *std::min_element(timestamps_.begin(), timestamps_.end());
+    }
+
+   NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+    std::array<std::uint64_t, static_cast<std::size_t>(Event::NUM_EVENTS)> timestamps_ = {};
+  };
+
   class Controller {
+   public:
+    struct State {
+      Byte state;
+
+      Byte piso;
+    };
+
    public:
     explicit Controller() {};
 
@@ -136,6 +240,28 @@ class NES final : public Clock {
       state_.b = pressed;
     }
 
+    /*
+     * The buttons pressed, a bit each, as latched on the next strobe.
+     */
+    [[nodiscard]]
+    Byte Buttons() const {
+      return state_.value;
+    }
+
+    void Buttons(Byte buttons) {
+      state_.value = buttons;
+    }
+
+    void Save(State* const state) const {
+      state->state = state_.value;
+      state->piso  = piso_;
+    }
+
+    void Load(const State& state) {
+      state_.value = state.state;
+      piso_        = state.piso;
+    }
+
    NESDEV_CORE_PRIVATE_UNLESS_TESTED:
     union {
       Byte value;
@@ -152,20 +278,312 @@ class NES final : public Clock {
     Byte piso_ = {0x00};
   };
 
+  /*
+   * Plain-data image of the machine, which snapshots start with, encoded. The memories whose sizes
+   * depend on the cartridge, i.e., the VRAM, PRG-RAM and CHR-RAM, follow it in this order.
+   */
+  struct State {
+    std::uint64_t cycle;
+
+    bool ppu_accessed;
+
+    bool nmi;
+
+    CPU::State cpu;
+
+    PPU::State ppu;
+
+    DirectMemoryAccess::State dma;
+
+    Controller::State controller_1;
+
+    Controller::State controller_2;
+
+    Byte ram[0x0800];
+
+    Byte io[0x0020];
+
+    Byte palette[0x0020];
+
+    Byte oam[0x0100];
+  };
+
+  /*
+   * The size of the State encoded, i.e., field by field in the order declared, with integers
+   * little-endian, sizes 8 bytes wide, bools a byte each and the opcode in flight told by whether
+   * it is engaged, so that snapshots do not depend on how the host lays the State out.
+   */
+  static std::size_t EncodedStateSize();
+
+  static void Encode(const State& state, Byte* const data);
+
+  /*
+   * Throws if the encoded state holds values the machine never does, e.g., of corrupted files.
+   */
+  static void Decode(const Byte* const data, State* const state);
+
+  /*
+   * Tells how speculating on a machine goes, so as to tell whether it pays off for the game.
+   */
+  struct SpeculationCounters {
+    // The writes to the PPU the CPU has run on past without waiting.
+    std::uint64_t writes;
+
+    // The times the CPU has needed the PPU as of now, i.e., on reads, OAM DMA starts and events.
+    std::uint64_t synchronizations;
+
+    // The synchronizations the PPU has been behind at, having the CPU wait.
+    std::uint64_t conflicts;
+
+    // The writes which have turned out to raise NMI, having the CPU run over again.
+    std::uint64_t rollbacks;
+  };
+};
+
+/*
+ * Composes the NES out of the specified CPU, PPU, bus and mapper types. Instantiated with the
+ * abstract interfaces, the components are interchangeable, e.g., with mocks, while instantiated
+ * with the final implementations, the calls the run loop makes every cycle get resolved at compile
+ * time. The mapper type must be the very type of the mapper the ROM comes with.
+ */
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+class BasicNES final : public NESBase {
  public:
-  NES(std::unique_ptr<ROM> rom);
+  /*
+   * Gets evaluated at every instruction boundary, i.e., when the CPU is about to fetch its next
+   * opcode, and stops execution when returns true. The PPU gets caught up with beforehand.
+   */
+  using Breakpoint = std::function<bool(const BasicNES&)>;
 
-  ~NES() = default;
+ public:
+  BasicNES(std::unique_ptr<ROM> rom, PPU::Rasterization rasterization = PPU::Rasterization::INLINE);
+
+  ~BasicNES();
 
   virtual void Tick() override;
 
  public:
+  void Run(std::size_t dots);
+
+  /*
+   * Runs until the PPU enters the post-render line, i.e., until a frame completes.
+   */
+  Status RunFrame(std::size_t dots = kUnlimited);
+
+  /*
+   * Runs the specified number of dots, i.e., cycles of the NES clock.
+   */
+  Status RunCycles(std::size_t dots);
+
+  /*
+   * Runs until the specified breakpoint gets hit, or the specified number of dots elapses.
+   */
+  Status RunUntil(const Breakpoint& breakpoint, std::size_t dots = kUnlimited);
+
+  void SkipOutput(bool skip);
+
+  /*
+   * Experimental. Runs the PPU on a worker thread, while the CPU runs on speculating that its
+   * writes to the PPU have nothing to do with it, and waits for the PPU only on reads and events.
+   * Writes enabling NMI are checkpointed, and should one raise NMI, i.e., in the middle of vblank,
+   * the CPU rolls back to it. Pays off on hosts with a core to spare, for games seldom reading the
+   * PPU. Breakpoints run serially. Requires the inline rasterization.
+   */
+  void Speculate(bool speculate);
+
+  [[nodiscard]]
+  bool IsSpeculating() const {
+    return worker_ != nullptr;
+  }
+
+  [[nodiscard]]
+  const SpeculationCounters& Speculation() const {
+    return speculation_;
+  }
+
+  /*
+   * Runs a frame with the input as is, then the specified number of frames further ahead, of
+   * which only the last one gets its pixels written, and restores the machine to the end of the
+   * first one. The frame presented thus reacts to the input that many frames earlier. Requires
+   * the inline rasterization, since the threaded one presents frames a frame late.
+   */
+  Status RunFrameAhead(std::size_t frames);
+
+  /*
+   * The size of the snapshots, which stays the same for the cartridge inserted.
+   */
+  [[nodiscard]]
+  std::size_t StateSize() const;
+
+  /*
+   * Writes a snapshot of the machine to the specified buffer, which takes StateSize bytes. The
+   * PPU gets caught up with beforehand, so that snapshots may be taken in between any calls.
+   */
+  void SaveState(Byte* const data, std::size_t size);
+
+  /*
+   * Restores the machine from the specified snapshot, taken of the very same cartridge. Pixels
+   * are written from scratch from then on.
+   */
+  void LoadState(const Byte* const data, std::size_t size);
+
+  /*
+   * Streams a snapshot out section by section, i.e., the State followed by each of the memories,
+   * the empty ones included, so that snapshots may be written out without being copied at once.
+   */
+  void SaveState(const StateWriter& writer);
+
+  /*
+   * Streams a snapshot in, having the specified reader fill each section in the order written,
+   * the memories right in place. The machine is left undefined should the reader throw.
+   */
+  void LoadState(const StateReader& reader);
+
+  /*
+   * Brings the machine back to the state it has been constructed in, reusing everything allocated.
+   * The memories are cleared, except the PRG-RAM of cartridges backed up by battery.
+   */
+  void PowerCycle();
+
+  /*
+   * Presses the reset button, which is taken once the instruction in flight completes. PPUCTRL and
+   * PPUMASK get cleared, while the memories are left as is.
+   */
+  void SoftReset();
+
+  /*
+   * Swaps the cartridge for the specified one in place, then power-cycles. The cartridge must be of
+   * the same mapper and chip sizes as the one inserted.
+   */
+  void LoadCartridge(const ROM& cartridge);
+
+  /*
+   * Creates another machine in the very same state, which shares the cartridge chips with this
+   * one until either writes to them. Forks are built as machines are, i.e., with buses, VRAM and
+   * chips of their own, some 24KB in all, besides the State; the layer cache of the PPU, some 240KB,
+   * is allocated only once composed from. Forks rasterize inline and start with their output
+   * skipped, having no framebuffer.
+   */
+  [[nodiscard]]
+  std::unique_ptr<BasicNES> Fork();
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  /*
+   * Hands OAM DMA writes over to the worker while speculating.
+   */
+  struct OAMWriter {
+    void WriteOAM(Byte address, Byte byte);
+
+    BasicNES* const nes;
+  };
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  template <bool kFrame, bool kBreakpoint, bool kSpeculative = false>
+  Status Drive(std::size_t dots, const Breakpoint* const breakpoint);
+
+  void CatchUp();
+
+  /*
+   * Brings the PPU up to the CPU about to access it. Returns false if the access must be dropped,
+   * the CPU having to roll back.
+   */
+  bool Access();
+
+  Byte ReadPPU(Address address);
+
+  void WritePPU(Address address, Byte byte);
+
+  /*
+   * Waits for the worker to take everything posted. Returns false if a write speculated on has
+   * raised NMI.
+   */
+  bool Synchronize();
+
+  /*
+   * Keeps the CPU side of the machine right after a write enabling NMI, i.e., the State but the
+   * PPU parts, along with PRG-RAM.
+   */
+  void Checkpoint();
+
+  void Rollback();
+
+  /*
+   * Copies the cartridge chips shared with forks, since copying them on write notifies the PPU,
+   * which must not happen while the worker runs it.
+   */
+  void Own();
+
+  void Poll();
+
+  bool Dispatch();
+
+  bool Dispatch(Scheduler::Event event);
+
+  void Schedule(Scheduler::Event event);
+
+  void Save(State* const state) const;
+
+  /*
+   * Applies the specified state, the memories being restored beforehand.
+   */
+  void Load(const State& state);
+
+  /*
+   * The memories snapshots end with, in order.
+   */
+  [[nodiscard]]
+  std::array<MemoryBank*, 3> Memories() const;
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  const PPU::Rasterization rasterization_;
+
+  Scheduler scheduler_;
+
+  // Value-initialized, so that power-cycling makes the same bytes as construction does.
+  State power_on_ = State();
+
+  // The snapshot run-ahead restores, kept so as not to allocate every frame.
+  std::vector<Byte> run_ahead_;
+
+  // The State as streamed in and out, kept so as not to allocate every snapshot.
+  std::vector<Byte> encoded_state_;
+
+  std::size_t ppu_pending_ = {0};
+
+  bool ppu_accessed_ = false;
+
+  bool nmi_ = false;
+
+  std::unique_ptr<detail::PPUWorker> worker_;
+
+  SpeculationCounters speculation_ = {};
+
+  // Set during the runs on the worker only, outside of which the PPU is run in place.
+  bool speculating_ = false;
+
+  // PPUCTRL as written by the CPU, so as to tell writes enabling NMI.
+  Byte ppuctrl_ = {0x00};
+
+  bool checkpoint_wanted_ = false;
+
+  bool checkpointed_ = false;
+
+  bool conflicted_ = false;
+
+  State checkpoint_ = State();
+
+  Byte checkpoint_ppuctrl_ = {0x00};
+
+  // PRG-ROM is left out, which ignores writes.
+  std::vector<Byte> checkpoint_prg_ram_;
 
  public:
   std::size_t cycle = {0};
   
   const std::unique_ptr<ROM> rom;
 
+  MapperT* const mapper;
+
   const std::unique_ptr<DirectMemoryAccess> dma;
 
   const std::unique_ptr<Controller> controller_1;
@@ -178,17 +596,24 @@ class NES final : public Clock {
 
   const std::unique_ptr<PPU::Chips> ppu_chips;
 
-  const std::unique_ptr<MMU> ppu_bus;
+  const std::unique_ptr<BusT> ppu_bus;
 
-  const std::unique_ptr<PPU> ppu;
+  const std::unique_ptr<PpuT> ppu;
 
   const std::unique_ptr<CPU::Registers> cpu_registers;
 
-  const std::unique_ptr<MMU> cpu_bus;
+  const std::unique_ptr<BusT> cpu_bus;
 
-  const std::unique_ptr<CPU> cpu;
+  const std::unique_ptr<CpuT> cpu;
 };
 
+/*
+ * Talks to every component through its abstract interface.
+ */
+using NES = BasicNES<CPU, PPU, MMU, ROM::Mapper>;
+
+extern template class BasicNES<CPU, PPU, MMU, ROM::Mapper>;
+
 }  // namespace core
 }  // namespace nesdev
 #endif  // ifndef _NESDEV_CORE_NES_H_
@@ -0,0 +1,267 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#ifndef _NESDEV_CORE_NETPLAY_H_
+#define _NESDEV_CORE_NETPLAY_H_
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+#include "nesdev/core/macros.h"
+#include "nesdev/core/types.h"
+
+namespace nesdev {
+namespace core {
+
+/*
+ * Carries the input of a player to the other one, frame by frame and in order.
+ */
+class Transport {
+ public:
+  struct Input {
+    std::uint32_t frame;
+
+    Byte buttons;
+  };
+
+ public:
+  virtual ~Transport() = default;
+
+  virtual void Send(const Input& input) = 0;
+
+  /*
+   * Takes the next input arrived, if any.
+   */
+  virtual bool Receive(Input* const input) = 0;
+};
+
+/*
+ * Connects two players within the process, delivering the input the specified number of ticks
+ * after it has been sent. Ticked once per frame, the delay is that many frames of latency.
+ */
+class Loopback final {
+ public:
+  explicit Loopback(std::size_t delay = 0);
+
+  // The ends refer back to the loopback.
+  Loopback(const Loopback&) = delete;
+
+  Loopback& operator=(const Loopback&) = delete;
+
+  /*
+   * The end of the specified player, either 0 or 1.
+   */
+  [[nodiscard]]
+  Transport* End(std::size_t player);
+
+  void Tick();
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  class Endpoint final : public Transport {
+   public:
+    Endpoint(Loopback* const loopback, std::size_t player)
+      : loopback_{loopback},
+        player_{player} {}
+
+    void Send(const Input& input) override;
+
+    bool Receive(Input* const input) override;
+
+   NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+    Loopback* const loopback_;
+
+    const std::size_t player_;
+  };
+
+  struct Packet {
+    std::uint64_t due;
+
+    Transport::Input input;
+  };
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  const std::size_t delay_;
+
+  std::uint64_t ticks_ = {0};
+
+  Endpoint ends_[2];
+
+  // The packets in flight to each player.
+  std::deque<Packet> queues_[2];
+};
+
+/*
+ * Runs one side of a two-player session with rollback. The input of the remote player is
+ * predicted to stay as last received, and a snapshot is taken at the start of every frame the
+ * remote input of which is yet to be confirmed. Once the input arrives and differs from the
+ * prediction, the machine is restored to the frame mispredicted, and re-simulated up to the
+ * present one with no pixels written.
+ *
+ * Up to the specified window of frames may run ahead of the remote input confirmed, beyond which
+ * frames stall until more input arrives.
+ */
+class Rollback final {
+ public:
+  /*
+   * Plays as the specified player, 0 or 1, i.e., on controller 1 or 2, over the transport.
+   */
+  Rollback(Transport* const transport, std::size_t player, std::size_t window = 8);
+
+  /*
+   * Sends the specified buttons of the local player, then runs a frame with them, rolling back
+   * first should the remote input received tell the prediction has failed. Returns false,
+   * running nothing and sending nothing, if the frame has to stall.
+   */
+  template <typename NES>
+  bool RunFrame(NES* const nes, Byte buttons) {
+    Synchronize(nes);
+    if (pending_.size() >= window_) {
+      stalls_++;
+      return false;
+    }
+    Frame frame = {buttons, pending_.size() < received_.size() ? received_[pending_.size()] : prediction_, Recycle()};
+    frame.snapshot.resize(nes->StateSize());
+    nes->SaveState(frame.snapshot.data(), frame.snapshot.size());
+    transport_->Send({static_cast<std::uint32_t>(confirmed_ + pending_.size()), buttons});
+    Feed(nes, frame);
+    pending_.push_back(std::move(frame));
+    nes->RunFrame();
+    return true;
+  }
+
+  /*
+   * Takes the remote input arrived, rolling back and re-simulating if mispredicted, without
+   * running any further.
+   */
+  template <typename NES>
+  void Synchronize(NES* const nes) {
+    Receive();
+    const std::size_t confirmed = std::min(received_.size(), pending_.size());
+    std::size_t mispredicted = confirmed;
+    for (std::size_t i = 0; i < confirmed; i++) {
+      if (pending_[i].remote != received_[i] && mispredicted == confirmed) mispredicted = i;
+      pending_[i].remote = received_[i];
+    }
+    if (mispredicted < confirmed) {
+      for (std::size_t i = confirmed; i < pending_.size(); i++) pending_[i].remote = received_[confirmed - 1];
+      Resimulate(nes, mispredicted);
+    }
+    Confirm(confirmed);
+  }
+
+  /*
+   * The number of frames run.
+   */
+  [[nodiscard]]
+  std::uint64_t Frames() const {
+    return confirmed_ + pending_.size();
+  }
+
+  /*
+   * The number of frames run with the remote input confirmed.
+   */
+  [[nodiscard]]
+  std::uint64_t Confirmed() const {
+    return confirmed_;
+  }
+
+  [[nodiscard]]
+  std::uint64_t Rollbacks() const {
+    return rollbacks_;
+  }
+
+  /*
+   * The number of frames run over again on rolling back.
+   */
+  [[nodiscard]]
+  std::uint64_t Resimulated() const {
+    return resimulated_;
+  }
+
+  [[nodiscard]]
+  std::uint64_t Stalls() const {
+    return stalls_;
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  struct Frame {
+    Byte local;
+
+    Byte remote;
+
+    // The machine at the start of the frame.
+    std::vector<Byte> snapshot;
+  };
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  /*
+   * Restores the specified pending frame and runs it through the present one.
+   */
+  template <typename NES>
+  void Resimulate(NES* const nes, std::size_t from) {
+    const bool skip = nes->ppu->IsSkippingOutput();
+    nes->ppu->SkipOutput(true);
+    nes->LoadState(pending_[from].snapshot.data(), pending_[from].snapshot.size());
+    for (std::size_t i = from; i < pending_.size(); i++) {
+      if (i > from) nes->SaveState(pending_[i].snapshot.data(), pending_[i].snapshot.size());
+      Feed(nes, pending_[i]);
+      nes->RunFrame();
+    }
+    nes->ppu->SkipOutput(skip);
+    rollbacks_++;
+    resimulated_ += pending_.size() - from;
+  }
+
+  template <typename NES>
+  void Feed(NES* const nes, const Frame& frame) const {
+    nes->controller_1->Buttons(player_ == 0 ? frame.local : frame.remote);
+    nes->controller_2->Buttons(player_ == 0 ? frame.remote : frame.local);
+  }
+
+  /*
+   * Queues the remote input arrived. Throws if it arrives out of order.
+   */
+  void Receive();
+
+  /*
+   * Drops the specified number of the oldest pending frames, the remote input of which has been
+   * confirmed, keeping their snapshots for reuse.
+   */
+  void Confirm(std::size_t frames);
+
+  std::vector<Byte> Recycle();
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  Transport* const transport_;
+
+  const std::size_t player_;
+
+  const std::size_t window_;
+
+  std::uint64_t confirmed_ = {0};
+
+  Byte prediction_ = {0x00};
+
+  // The frames run ahead of the remote input confirmed, oldest first.
+  std::deque<Frame> pending_;
+
+  // The remote input of the frames from the first pending one on.
+  std::deque<Byte> received_;
+
+  std::vector<std::vector<Byte>> free_;
+
+  std::uint64_t rollbacks_ = {0};
+
+  std::uint64_t resimulated_ = {0};
+
+  std::uint64_t stalls_ = {0};
+};
+
+}  // namespace core
+}  // namespace nesdev
+#endif  // ifndef _NESDEV_CORE_NETPLAY_H_
@@ -8,6 +8,7 @@
 #define _NESDEV_CORE_PPU_H_
 #include <climits>
 #include <cstddef>
+#include <cstdint>
 #include <algorithm>
 #include <array>
 #include <functional>
@@ -30,9 +31,32 @@ class PPU : public Clock {
 
   static const int kFrameH = 240;
 
+  static const int kPatternTableW = 128;
+
+  static const int kPatternTableH = 128;
+
+  static const int kNametablesW = 2 * kFrameW;
+
+  static const int kNametablesH = 2 * kFrameH;
+
+  static const int kSpritesW = 64;
+
+  static const int kSpritesH = 128;
+
+  static const int kPaletteSize = 32;
+
  public:
   using PixelWriter = std::function<void(std::int16_t, std::int16_t, ARGB)>;
 
+  /*
+   * Specifies where pixels are composed. THREADED keeps only the timing on the emulating thread
+   * and composes pixels on a worker thread, delivering each frame to the framebuffer one frame late.
+   */
+  enum class Rasterization : Byte {
+    INLINE,
+    THREADED
+  };
+
   /*
    * The following registers are defined according to the folloing Loopy's archetecture.
    * [SEE] https://wiki.nesdev.com/w/index.php/PPU_scrolling
@@ -171,23 +195,14 @@ class PPU : public Clock {
       Address value;
       Shifter<Address> shift;
     } background_attr_hi = {0x0000};
-    // Sprite pattern low bits
-    union {
-      Address value;
-      Shifter<Address> shift;
-    } sprite_pttr_lo[kNumSprites] = {{0x0000}};
-    // Sprite pattern high bits
+    // Sprite pixels of the scanline, each of which is taken from the first opaque sprite in OAM order
     union {
-      Address value;
-      Shifter<Address> shift;
-    } sprite_pttr_hi[kNumSprites] = {{0x0000}};
-  };
-
-  struct Chips {
-    Chips(std::unique_ptr<MemoryBank> oam)
-      : oam{std::move(oam)} {}
-
-    const std::unique_ptr<MemoryBank> oam;
+      Byte value;
+      Bitfield<0, 2, Byte> pixel;                      // Pattern of the pixel (0: transparent)
+      Bitfield<2, 2, Byte> palette;                    // Sprite palette
+      Bitfield<4, 1, Byte> priority;                   // Priority (0: in front of background; 1: behind background)
+      Bitfield<5, 1, Byte> sprite_zero;                // 1: The pixel belongs to sprite 0
+    } sprite_line[kFrameW] = {{0x00}};
   };
 
   template <Address From, Address To>
@@ -201,8 +216,21 @@ class PPU : public Clock {
     Nametables(std::size_t size, ROM* const rom)
       : rom_{rom},
         size_{size} {
-      data_[0].resize(size_);
-      data_[1].resize(size_);
+      NESDEV_CORE_CASSERT(size_ == 0x0400, "Size does not match nametable size");
+      data_.resize(0x04 * size_);
+      rom_->mapper->OnMirroringChanged([this](enum ROM::Header::Mirroring mirroring) { Mirror(mirroring); });
+    }
+
+    /*
+     * Laid out as specified, and left to the owner to mirror otherwise, e.g., for those owned by
+     * another thread than the one the mapper notifies on.
+     */
+    Nametables(std::size_t size, enum ROM::Header::Mirroring mirroring)
+      : rom_{nullptr},
+        size_{size} {
+      NESDEV_CORE_CASSERT(size_ == 0x0400, "Size does not match nametable size");
+      data_.resize(0x04 * size_);
+      Mirror(mirroring);
     }
 
     [[nodiscard]]
@@ -221,16 +249,25 @@ class PPU : public Clock {
       else NESDEV_CORE_THROW(InvalidAddress::Occur("Invalid address specified to Write", address));
     }
 
+    /*
+     * The size of the physical VRAM, including the one four screen cartridges provide, which the
+     * four logical nametables are mapped into.
+     */
     std::size_t Size() const override {
-      return size_;
+      return data_.size();
     }
 
     Byte* Data() override {
-      NESDEV_CORE_THROW(NotImplemented::Occur("Not implemented method operated to Nametables"));
+      return const_cast<Byte*>(std::as_const(*this).Data());
     }
 
     const Byte* Data() const override {
-      NESDEV_CORE_THROW(NotImplemented::Occur("Not implemented method operated to Nametables"));
+      return data_.data();
+    }
+
+    const Byte* PageAt(Address address) const override {
+      if (HasValidAddress(address)) return PtrTo(address & ~0x03FF);
+      else return nullptr;
     }
 
    NESDEV_CORE_PRIVATE_UNLESS_TESTED:
@@ -239,31 +276,40 @@ class PPU : public Clock {
     }
 
     const Byte* PtrTo(Address address) const {
-      address %= 0x1000;
-      switch(rom_->header->Mirroring()) {
-      case ROM::Header::Mirroring::HORIZONTAL:
-        if (address >= 0x0000 && address <= 0x03FF) return &data_[0x00].data()[address % Size()];
-        if (address >= 0x0400 && address <= 0x07FF) return &data_[0x00].data()[address % Size()];
-        if (address >= 0x0800 && address <= 0x0BFF) return &data_[0x01].data()[address % Size()];
-        if (address >= 0x0C00 && address <= 0x0FFF) return &data_[0x01].data()[address % Size()];
-        NESDEV_CORE_THROW(InvalidAddress::Occur("Invalid address specified to Nametables", address));
-      case ROM::Header::Mirroring::VERTICAL:
-        if (address >= 0x0000 && address <= 0x03FF) return &data_[0x00].data()[address % Size()];
-        if (address >= 0x0400 && address <= 0x07FF) return &data_[0x01].data()[address % Size()];
-        if (address >= 0x0800 && address <= 0x0BFF) return &data_[0x00].data()[address % Size()];
-        if (address >= 0x0C00 && address <= 0x0FFF) return &data_[0x01].data()[address % Size()];
-        NESDEV_CORE_THROW(InvalidAddress::Occur("Invalid address specified to Nametables", address));
+      return &pages_[(address >> 10) & 0x03][address & 0x03FF];
+    }
+
+   public:
+    /*
+     * Resolves the mirroring into the four logical nametables, each of which points to a
+     * 1KB physical page. Four screen layout uses the extra VRAM provided by the cartridge.
+     * [SEE] https://wiki.nesdev.com/w/index.php/Mirroring
+     */
+    void Mirror(enum ROM::Header::Mirroring mirroring) {
+      switch(mirroring) {
+      case ROM::Header::Mirroring::HORIZONTAL:   Map(0x00, 0x00, 0x01, 0x01); break;
+      case ROM::Header::Mirroring::VERTICAL:     Map(0x00, 0x01, 0x00, 0x01); break;
+      case ROM::Header::Mirroring::ONESCREEN_LO: Map(0x00, 0x00, 0x00, 0x00); break;
+      case ROM::Header::Mirroring::ONESCREEN_HI: Map(0x01, 0x01, 0x01, 0x01); break;
+      case ROM::Header::Mirroring::FOURSCREEN:   Map(0x00, 0x01, 0x02, 0x03); break;
       default:
         NESDEV_CORE_THROW(InvalidROM::Occur("Incompatible mirroring specified to ROM"));
       }
     }
 
+   NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+    void Map(std::size_t top_l, std::size_t top_r, std::size_t bottom_l, std::size_t bottom_r) {
+      pages_ = {&data_[top_l * size_], &data_[top_r * size_], &data_[bottom_l * size_], &data_[bottom_r * size_]};
+    }
+
   NESDEV_CORE_PRIVATE_UNLESS_TESTED:
     ROM* const rom_;
 
     std::size_t size_;
 
-    std::array<std::vector<Byte>, 0x02> data_;
+    std::vector<Byte> data_;
+
+    std::array<Byte*, 0x04> pages_ = {};
   };
 
   template <Address From, Address To>
@@ -300,11 +346,11 @@ class PPU : public Clock {
     }
 
     Byte* Data() override {
-      NESDEV_CORE_THROW(NotImplemented::Occur("Not implemented method operated to Palette"));
+      return const_cast<Byte*>(std::as_const(*this).Data());
     }
 
     const Byte* Data() const override {
-      NESDEV_CORE_THROW(NotImplemented::Occur("Not implemented method operated to Palette"));
+      return data_.data();
     }
 
    NESDEV_CORE_PRIVATE_UNLESS_TESTED:
@@ -330,6 +376,10 @@ class PPU : public Clock {
   template <std::size_t Entries=64>
   class ObjectAttributeMap final : public MemoryBank {
    public:
+    static_assert(
+      Entries <= CHAR_BIT * sizeof(std::uint64_t),
+      "Number of entries must fit in the scanline collision mask");
+
     struct Entry {
       Byte y;
       Byte id;
@@ -337,7 +387,14 @@ class PPU : public Clock {
       Byte x;
     };
 
+    // Bit i is set when the i-th entry collides to the scanline.
+    using Collision = std::uint64_t;
+
    public:
+    ObjectAttributeMap() {
+      for (std::size_t entry = 0; entry < Entries; entry++) Index(entry);
+    }
+
     [[nodiscard]]
     bool HasValidAddress(Address address) const override {
       return address >= 0 && address < sizeof(Entry) * Entries;
@@ -349,7 +406,17 @@ class PPU : public Clock {
     }
 
     void Write(Address address, Byte byte) override {
-      if (HasValidAddress(address)) *PtrTo(address) = byte;
+      if (HasValidAddress(address)) {
+        // Only y coordinates affect the scanline collisions, so the other bytes are
+        // written through without touching the index.
+        if (address % sizeof(Entry) == 0 && *PtrTo(address) != byte) {
+          Unindex(address / sizeof(Entry));
+          *PtrTo(address) = byte;
+          Index(address / sizeof(Entry));
+        } else {
+          *PtrTo(address) = byte;
+        }
+      }
       else NESDEV_CORE_THROW(InvalidAddress::Occur("Invalid address specified to Write", address));
     }
 
@@ -357,6 +424,22 @@ class PPU : public Clock {
       return Entries;
     }
 
+    /*
+     * Returns the entries which "collide" to the specified scanline, that is, the entries
+     * whose y coordinate satisfies 0 <= scanline - y < height. The index is maintained on
+     * each write, so sprite evaluation does not have to scan the whole OAM per scanline.
+     */
+    [[nodiscard]]
+    Collision CollisionsAt(std::int16_t scanline, bool is_8x8_mode) const {
+      NESDEV_CORE_CASSERT(scanline >= 0 && scanline < kFrameH, "Invalid scanline specified to CollisionsAt");
+      return collisions_[is_8x8_mode ? 0 : 1][scanline];
+    }
+
+    [[nodiscard]]
+    const Entry& At(std::size_t entry) const {
+      return data_[entry];
+    }
+
     Byte* Data() override {
       return PtrTo(0);
     }
@@ -374,8 +457,38 @@ class PPU : public Clock {
       return &reinterpret_cast<const Byte*>(data_)[address];
     }
 
+    void Index(std::size_t entry) {
+      Mark(entry, true);
+    }
+
+    void Unindex(std::size_t entry) {
+      Mark(entry, false);
+    }
+
+    void Mark(std::size_t entry, bool collides) {
+      const Collision bit = Collision{1} << entry;
+      for (std::size_t mode = 0; mode < 2; mode++) {
+        // Entries whose y coordinate exceeds the frame height never collide.
+        const int to = std::min(data_[entry].y + (mode == 0 ? 8 : 16), kFrameH);
+        for (int line = data_[entry].y; line < to; line++) {
+          if (collides) collisions_[mode][line] |= bit;
+          else collisions_[mode][line] &= ~bit;
+        }
+      }
+    }
+
   NESDEV_CORE_PRIVATE_UNLESS_TESTED:
-    Entry data_[Entries];
+    Entry data_[Entries] = {};
+
+    // Scanline collisions for 8x8 and 8x16 sprite modes respectively.
+    std::array<std::array<Collision, kFrameH>, 2> collisions_ = {};
+  };
+
+  struct Chips {
+    Chips(std::unique_ptr<ObjectAttributeMap<>> oam)
+      : oam{std::move(oam)} {}
+
+    const std::unique_ptr<ObjectAttributeMap<>> oam;
   };
 
  public:
@@ -386,10 +499,16 @@ class PPU : public Clock {
 
   virtual void Tick() override = 0;
 
+  virtual void Run(std::size_t dots) {
+    for (; dots > 0; dots--) Tick();
+  }
+
   virtual Byte Read(Address address) = 0;
 
   virtual void Write(Address address, Byte byte) = 0;
 
+  virtual void WriteOAM(Byte address, Byte byte) = 0;
+
   virtual bool IsRendering() const = 0;
 
   virtual Byte CtrlRegister() const = 0;
@@ -408,14 +527,76 @@ class PPU : public Clock {
 
   virtual Address BgAttrHi() const = 0;
 
+  /*
+   * Views for tooling, decoded straight from memory without going through the registers, so that
+   * neither the latches nor the VRAM address get disturbed. Each view is written row by row into
+   * the specified buffer, which must hold its width times height pixels:
+   * - RenderPatternTable: the 16x16 tiles of the specified table in the specified palette.
+   * - RenderNametables:   all four nametables, laid out as they are scrolled over.
+   * - RenderSprites:      the 64 OAM entries in OAM order, 8 in a row, each in a 8x16 cell.
+   * - RenderPalette:      the 32 palette entries.
+   */
+  virtual void RenderPatternTable(std::size_t table, Byte palette, ARGB* const pixels) const = 0;
+
+  virtual void RenderNametables(ARGB* const pixels) const = 0;
+
+  virtual void RenderSprites(ARGB* const pixels) const = 0;
+
+  virtual void RenderPalette(ARGB* const colours) const = 0;
+
  public:
   void Connect(ROM* const rom) {
     NESDEV_CORE_CASSERT(rom, "Invalid ROM specified to Connect");
     rom_ = rom;
+    rom_->mapper->OnMirroringChanged([this](enum ROM::Header::Mirroring) { Remap(); });
+    rom_->mapper->OnBanksSwitched([this]() { Remap(); });
+  }
+
+  /*
+   * Resolves the pages the PPU fetches from, when the mirroring changes or banks get switched.
+   */
+  virtual void Remap() {
+    // Do nothing.
   }
 
+  /*
+   * Waits for whatever gets composed in the background to be done, e.g., before the contents of
+   * the cartridge get replaced.
+   */
+  virtual void Quiesce() {
+    // Do nothing.
+  }
+
+  /*
+   * Pixels of frames identical to the previous one are not written, so the writer's target is
+   * expected to keep the frame last written to it. See IsFrameUnchanged.
+   */
   void Framebuffer(PixelWriter pixel_writer) {
     context_.pixel_writer = pixel_writer;
+    context_.unchanged    = false;
+    context_.presented    = false;
+  }
+
+  /*
+   * Skips composing pixels, e.g., for fast-forwarding or frames nobody looks at. The timing, i.e.,
+   * vblank, NMI, mapper callbacks and sprite 0 hit, stays exact. Meant to be toggled between frames.
+   */
+  void SkipOutput(bool skip) {
+    context_.skip_output = skip;
+  }
+
+  [[nodiscard]]
+  bool IsSkippingOutput() const {
+    return context_.skip_output;
+  }
+
+  /*
+   * Whether the frame last delivered to the pixel writer is identical to the one before, in which
+   * case none of its pixels has been written, e.g., so that frontends can skip uploading it.
+   */
+  [[nodiscard]]
+  bool IsFrameUnchanged() const {
+    return context_.frame_unchanged;
   }
 
   [[nodiscard]]
@@ -449,6 +630,25 @@ class PPU : public Clock {
     return colours_.Get(intensity, colour);
   }
 
+  /*
+   * Counts the dots until the PPU arrives at the specified position. The dot skipped on odd frames
+   * is taken as skipped whether or not rendering is enabled by then, which is decided only once
+   * the PPU gets there, so that the result may fall short of the actual count by one.
+   */
+  [[nodiscard]]
+  std::size_t DotsUntil(std::int16_t scanline, std::int16_t cycle) const {
+    constexpr long kDotsPerFrame = 262 * 341;
+    // Dot 0 of the first visible line, counted from the pre-render line, where frames transit.
+    constexpr long kSkipped = 341;
+    const long from    = (context_.scanline + 1) * 341L + context_.cycle;
+    const long to      = (scanline + 1) * 341L + cycle;
+    const long dots    = ((to - from) % kDotsPerFrame + kDotsPerFrame) % kDotsPerFrame;
+    const long until   = dots == 0 ? kDotsPerFrame : dots;
+    const long skipped = ((kSkipped - from) % kDotsPerFrame + kDotsPerFrame) % kDotsPerFrame;
+    const bool odd     = from <= kSkipped ? context_.odd_frame : !context_.odd_frame;
+    return odd && skipped < until && until > 1 ? until - 1 : until;
+  }
+
   /* [SEE] https://wiki.nesdev.com/w/index.php/PPU_rendering */
   [[nodiscard]]
   bool IsPreRenderOrVisibleLine() const {
@@ -507,6 +707,9 @@ class PPU : public Clock {
       scanline        = {0};
       num_sprites     = {0};
       odd_frame       = false;
+      unchanged       = false;
+      presented       = false;
+      frame_unchanged = false;
       background.id   = {0x00};
       background.attr = {0x00};
       background.lsb  = {0x00};
@@ -537,8 +740,74 @@ class PPU : public Clock {
     std::size_t num_sprites = {0};
 
     PixelWriter pixel_writer;
+
+    bool skip_output = false;
+
+    bool offloaded = false;
+
+    // Nothing has changed since the previous frame, which the pixel writer holds.
+    bool unchanged = false;
+
+    // The pixel writer holds the frame being rendered, unless it is left unchanged.
+    bool presented = false;
+
+    bool frame_unchanged = false;
+
+    [[nodiscard]]
+    bool IsWriting() const {
+      return !(skip_output || offloaded || unchanged);
+    }
   };
 
+ public:
+  /*
+   * Plain-data image of the PPU, but the memories it is connected to. The pixel writer's target
+   * is not a part of the PPU, so that the frame being rendered gets written from scratch on load.
+   */
+  struct State {
+    Registers registers;
+
+    Shifters shifters;
+
+    std::int16_t cycle;
+
+    std::int16_t scanline;
+
+    bool odd_frame;
+
+    Context::Background background;
+
+    ObjectAttributeMap<>::Entry sprite[kNumSprites];
+
+    std::size_t num_sprites;
+
+    Byte latch;
+
+    Byte deffered;
+
+    bool is_latched;
+
+    bool may_sprite_zero_hit;
+
+    bool sprite_zero_rendered;
+
+    bool prefetched;
+
+    bool altered;
+
+    std::uint64_t inputs;
+  };
+
+  virtual void Save(State* const state) const = 0;
+
+  /*
+   * Restores the specified state, provided that the memories it is connected to have been
+   * restored beforehand.
+   */
+  virtual void Load(const State& state) = 0;
+
+ NESDEV_CORE_PROTECTED_UNLESS_TESTED:
+
   /*
    * Predefined palette stored in VGA Palette format.
    * [SEE] https://wiki.nesdev.com/w/index.php/.pal
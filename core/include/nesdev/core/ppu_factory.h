@@ -10,6 +10,7 @@
 #include <vector>
 #include "nesdev/core/ppu.h"
 #include "nesdev/core/mmu.h"
+#include "nesdev/core/rom.h"
 #include "nesdev/core/types.h"
 
 namespace nesdev {
@@ -22,6 +23,13 @@ class PPUFactory {
                                      PPU::Registers* const registers,
                                      PPU::Shifters* const shifters,
                                      MMU* const mmu);
+
+  [[nodiscard]]
+  static std::unique_ptr<PPU> ThreadedRP2C02(PPU::Chips* const chips,
+                                             PPU::Registers* const registers,
+                                             PPU::Shifters* const shifters,
+                                             MMU* const mmu,
+                                             ROM* const rom);
 };
 
 }  // namespace core
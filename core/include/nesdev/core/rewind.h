@@ -0,0 +1,136 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#ifndef _NESDEV_CORE_REWIND_H_
+#define _NESDEV_CORE_REWIND_H_
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include "nesdev/core/macros.h"
+#include "nesdev/core/types.h"
+
+namespace nesdev {
+namespace core {
+
+/*
+ * Keeps the history of a machine within a fixed memory budget. A snapshot is taken every given
+ * number of frames, and stored as the XOR delta against the previous one, compressed, since RAM
+ * and VRAM change very little per frame. Every given number of snapshots is a keyframe, i.e., is
+ * stored as is, compressed. Once the budget gets exceeded, the oldest keyframe is dropped along
+ * with the deltas depending on it.
+ *
+ * Rewinding restores the latest snapshot and drops it. The one before is then rebuilt by XORing
+ * the delta back, or, if the latest one was a keyframe, by replaying the deltas of the previous
+ * keyframe.
+ */
+class Rewind final {
+ public:
+  /*
+   * Keeps as many snapshots as the specified budget in bytes allows, taken every specified number
+   * of frames, a keyframe every specified number of snapshots.
+   */
+  explicit Rewind(std::size_t budget, std::size_t interval = 1, std::size_t keyframe_interval = 60);
+
+  /*
+   * Supposed to be called every frame, takes a snapshot of the specified NES when due.
+   */
+  template <typename NES>
+  void Capture(NES* const nes) {
+    if (frames_++ % interval_ != 0) return;
+    current_.resize(nes->StateSize());
+    nes->SaveState(current_.data(), current_.size());
+    Push();
+  }
+
+  /*
+   * Restores the specified NES to the latest snapshot, which is dropped. Returns false if there is
+   * no history left.
+   */
+  template <typename NES>
+  bool Step(NES* const nes) {
+    if (!Pop()) return false;
+    nes->LoadState(current_.data(), current_.size());
+    return true;
+  }
+
+  /*
+   * Drops the whole history.
+   */
+  void Clear();
+
+  /*
+   * The number of snapshots kept.
+   */
+  [[nodiscard]]
+  std::size_t Count() const {
+    return entries_.size();
+  }
+
+  /*
+   * The bytes the snapshots kept take, which stays within the budget, unless a single keyframe and
+   * its deltas take more, in which case the next snapshot is taken as a keyframe.
+   */
+  [[nodiscard]]
+  std::size_t Usage() const {
+    return usage_;
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  struct Entry {
+    bool keyframe;
+
+    std::vector<Byte> data;
+  };
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  /*
+   * Stores the snapshot just taken, which becomes the latest one.
+   */
+  void Push();
+
+  /*
+   * Brings the latest snapshot to the current one and drops it, rebuilding the one before.
+   */
+  bool Pop();
+
+  void Evict();
+
+  /*
+   * Rebuilds the latest snapshot kept out of its keyframe.
+   */
+  void Replay();
+
+  void Recycle(Entry* const entry);
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  const std::size_t budget_;
+
+  const std::size_t interval_;
+
+  const std::size_t keyframe_interval_;
+
+  std::size_t frames_ = {0};
+
+  std::size_t usage_ = {0};
+
+  // The number of snapshots since the latest keyframe, inclusive.
+  std::size_t since_keyframe_ = {0};
+
+  std::deque<Entry> entries_;
+
+  std::vector<std::vector<Byte>> free_;
+
+  // The latest snapshot kept, uncompressed.
+  std::vector<Byte> latest_;
+
+  std::vector<Byte> current_;
+
+  std::vector<Byte> delta_;
+};
+
+}  // namespace core
+}  // namespace nesdev
+#endif  // ifndef _NESDEV_CORE_REWIND_H_
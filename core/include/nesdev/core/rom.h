@@ -6,7 +6,11 @@
  */
 #ifndef _NESDEV_CORE_ROM_H_
 #define _NESDEV_CORE_ROM_H_
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <utility>
 #include <vector>
 #include "nesdev/core/exceptions.h"
 #include "nesdev/core/macros.h"
@@ -35,7 +39,8 @@ struct ROM {
       VERTICAL,
       HARDWARE,
       ONESCREEN_LO,
-      ONESCREEN_HI
+      ONESCREEN_HI,
+      FOURSCREEN
     };
 
     enum class TVSystem : Byte {
@@ -45,6 +50,10 @@ struct ROM {
     };
 
    public:
+    Header() = default;
+
+    Header(const Header&) = default;
+
     [[nodiscard]]
     bool HasValidMagic() const {
       return magic_[0] == 0x4E && magic_[1] == 0x45 && magic_[2] == 0x53 && magic_[3] == 0x1A;
@@ -106,6 +115,8 @@ struct ROM {
 
     [[nodiscard]]
     Header::Mirroring Mirroring() const {
+      // Cartridges providing extra VRAM ignore the mirroring control bit.
+      if (flags6_.ignore_mirroring) return Header::Mirroring::FOURSCREEN;
       return flags6_.mirroring ? Header::Mirroring::VERTICAL : Header::Mirroring::HORIZONTAL;
     }
 
@@ -171,6 +182,12 @@ struct ROM {
       return flags10_.has_bus_conflict;
     }
 
+   private:
+    friend struct ROM;
+
+    // Replaced by ROM::Insert only, so that whatever refers to the header sees the one inserted.
+    Header& operator=(const Header&) = default;
+
   NESDEV_CORE_PRIVATE_UNLESS_TESTED:  
     // FLAGS 0-3  : ("NES" followed by MS-DOS end-of-file)
     Byte magic_[4] = {0x00, 0x00, 0x00, 0x00};
@@ -253,6 +270,10 @@ struct ROM {
       PPU
     };
 
+    using MirroringHandler = std::function<void(enum Header::Mirroring)>;
+
+    using BanksHandler = std::function<void()>;
+
    public:
     explicit Mapper(Header* const header, Chips* const chips) : header_{header}, chips_{chips} {};
 
@@ -265,6 +286,13 @@ struct ROM {
 
     virtual void Write(Space space, Address address, Byte byte) const = 0;
 
+    /*
+     * Points to the 1KB page of the bank currently switched in at the specified address, or
+     * nullptr if the address is not backed by a bank in place.
+     */
+    [[nodiscard]]
+    virtual const Byte* PageAt(Space space, Address address) const = 0;
+
     [[nodiscard]]
     virtual bool IRQ() const = 0;
 
@@ -272,12 +300,62 @@ struct ROM {
 
     virtual void OnVisibleCycleEnds() = 0;
 
+    /*
+     * Tells whether the mapper counts the scanlines notified by OnVisibleCycleEnds, e.g., so as to
+     * raise IRQ, in which case the machine polls it at the end of the visible cycles.
+     */
+    [[nodiscard]]
+    virtual bool CountsScanlines() const = 0;
+
     virtual void Reset() = 0;
 
+    [[nodiscard]]
+    virtual enum Header::Mirroring Mirroring() const = 0;
+
+   public:
+    /*
+     * Mirroring may be switched by mappers at runtime, so the nametables subscribe to the
+     * changes here and resolve their page layout only when the mirroring actually changes.
+     */
+    void OnMirroringChanged(MirroringHandler handler) {
+      handler(Mirroring());
+      on_mirroring_changed_.push_back(std::move(handler));
+    }
+
+    /*
+     * Likewise, pages pointed by PageAt are valid until mappers switch banks.
+     */
+    void OnBanksSwitched(BanksHandler handler) {
+      handler();
+      on_banks_switched_.push_back(std::move(handler));
+    }
+
+    /*
+     * Notifies the subscribers as if both the mirroring and the banks have changed, which they may
+     * have once the contents of the cartridge get replaced.
+     */
+    void Refresh() const {
+      MirroringChanged();
+      BanksSwitched();
+    }
+
+   NESDEV_CORE_PROTECTED_UNLESS_TESTED:
+    void MirroringChanged() const {
+      for (auto& handler : on_mirroring_changed_) handler(Mirroring());
+    }
+
+    void BanksSwitched() const {
+      for (auto& handler : on_banks_switched_) handler();
+    }
+
    NESDEV_CORE_PROTECTED_UNLESS_TESTED:
     const Header* const header_;
 
     Chips* const chips_;
+
+    std::vector<MirroringHandler> on_mirroring_changed_;
+
+    std::vector<BanksHandler> on_banks_switched_;
   };
 
   explicit ROM(std::unique_ptr<Header> header,
@@ -285,15 +363,73 @@ struct ROM {
                std::unique_ptr<Mapper> mapper)
     : header{std::move(header)},
       mapper{std::move(mapper)},
-      chips{std::move(chips)} {};
+      chips{std::move(chips)},
+      hash_{HashOf(*this->chips)} {};
+
+  /*
+   * Takes the hash as is, for cartridges sharing the chips of one already hashed.
+   */
+  explicit ROM(std::unique_ptr<Header> header,
+               std::unique_ptr<Chips> chips,
+               std::unique_ptr<Mapper> mapper,
+               std::uint64_t hash)
+    : header{std::move(header)},
+      mapper{std::move(mapper)},
+      chips{std::move(chips)},
+      hash_{hash} {};
 
   virtual ~ROM() = default;
 
-  const std::unique_ptr<const Header> header;
+  /*
+   * Takes over the contents of the specified cartridge, which must be of the very same layout,
+   * i.e., of the same mapper and chip sizes, so that whatever refers to this one stays valid.
+   */
+  void Insert(const ROM& other) {
+    if (other.header->Mapper() != header->Mapper())
+      NESDEV_CORE_THROW(InvalidROM::Occur("Cartridge of another mapper specified to nesdev::core::ROM::Insert"));
+    const std::pair<MemoryBank*, const MemoryBank*> pairs[] = {
+      {chips->chr_rom.get(), other.chips->chr_rom.get()},
+      {chips->chr_ram.get(), other.chips->chr_ram.get()},
+      {chips->prg_rom.get(), other.chips->prg_rom.get()},
+      {chips->prg_ram.get(), other.chips->prg_ram.get()}};
+    for (const auto& [to, from] : pairs)
+      if (to->Size() != from->Size())
+        NESDEV_CORE_THROW(InvalidROM::Occur("Cartridge of another layout specified to nesdev::core::ROM::Insert"));
+    for (const auto& [to, from] : pairs)
+      if (to->Size() > 0) std::copy_n(from->Data(), from->Size(), to->Data());
+    *header = *other.header;
+    hash_ = other.hash_;
+    mapper->Refresh();
+  }
+
+  /*
+   * Identifies the cartridge by the FNV-1a hash of its PRG-ROM followed by its CHR-ROM, as loaded.
+   */
+  [[nodiscard]]
+  std::uint64_t Hash() const {
+    return hash_;
+  }
+
+  // Read-only to everything but Insert, which alone may assign headers.
+  const std::unique_ptr<Header> header;
 
   const std::unique_ptr<Mapper> mapper;
 
   const std::unique_ptr<Chips> chips;
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  static std::uint64_t HashOf(const Chips& chips) {
+    std::uint64_t hash = 0xCBF29CE484222325;
+    for (const auto* const rom : {chips.prg_rom.get(), chips.chr_rom.get()}) {
+      if (rom->Size() == 0) continue;
+      const Byte* const data = std::as_const(*rom).Data();
+      for (std::size_t i = 0; i < rom->Size(); i++) hash = (hash ^ data[i]) * 0x00000100000001B3;
+    }
+    return hash;
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  std::uint64_t hash_;
 };
 
 }  // namespace core
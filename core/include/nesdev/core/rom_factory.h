@@ -17,6 +17,13 @@ class ROMFactory {
  public:
   [[nodiscard]]
   static std::unique_ptr<ROM> NROM(std::istream &bytestream);
+
+  /*
+   * Inserts another cartridge in the very same state as the specified one, sharing its chips
+   * until either of them writes to them.
+   */
+  [[nodiscard]]
+  static std::unique_ptr<ROM> NROM(const ROM& rom);
 };
 
 }  // namespace core
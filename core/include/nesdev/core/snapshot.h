@@ -0,0 +1,174 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#ifndef _NESDEV_CORE_SNAPSHOT_H_
+#define _NESDEV_CORE_SNAPSHOT_H_
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nesdev/core/macros.h"
+#include "nesdev/core/types.h"
+
+namespace nesdev {
+namespace core {
+
+/*
+ * The save-state file format. A file starts with a header, followed by a chunk per section of the
+ * snapshot the NES streams out, i.e., the machine state covering the CPU, PPU, RAM, OAM and palette
+ * RAM, then the VRAM, PRG-RAM and CHR-RAM. Each chunk consists of a chunk header and its payload
+ * compressed in LZ77 style. All the integers are little-endian, those of the machine state included,
+ * as it gets encoded field by field (see NESBase::Encode) rather than dumped as the host lays it out.
+ *
+ * Header : "NESS", version (4 bytes), ROM hash (8 bytes), number of chunks (4 bytes)
+ * Chunk  : tag (4 bytes), uncompressed size (4 bytes), compressed size (4 bytes), payload
+ *
+ * The version must be bumped whenever the layout of the sections changes.
+ */
+class Snapshot {
+ public:
+  static constexpr std::uint32_t kVersion = 2;
+
+  static constexpr std::size_t kNumChunks = 4;
+
+  // Tags of the chunks in order.
+  static constexpr char kTags[kNumChunks][4] = {{'S', 'T', 'A', 'T'}, {'V', 'R', 'A', 'M'}, {'P', 'R', 'A', 'M'}, {'C', 'R', 'A', 'M'}};
+
+  static constexpr std::size_t kHeaderSize = 20;
+
+  static constexpr std::size_t kChunkHeaderSize = 12;
+
+ public:
+  /*
+   * Appends the specified bytes compressed to the specified buffer, returning the compressed size.
+   */
+  static std::size_t Compress(const Byte* const data, std::size_t size, std::vector<Byte>* const out);
+
+  /*
+   * Reads the specified number of compressed bytes off the stream, decompressing them straight to
+   * the specified destination, which must take exactly the specified size once decompressed.
+   */
+  static void Decompress(std::istream& is, std::size_t compressed, Byte* const data, std::size_t size);
+
+  static void Decompress(const Byte* const compressed, std::size_t compressed_size, Byte* const data, std::size_t size);
+
+  /*
+   * Restores the specified NES from a save-state file, decompressing the chunks one by one right
+   * into the machine. Throws if the file is of another version or another cartridge.
+   */
+  template <typename NES>
+  static void Load(std::istream& is, NES* const nes) {
+    Reader reader(is, nes->rom->Hash());
+    nes->LoadState([&reader](Byte* const data, std::size_t size) { reader.Read(data, size); });
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  /*
+   * Validates the header on construction, then reads chunks in order.
+   */
+  class Reader {
+   public:
+    Reader(std::istream& is, std::uint64_t rom_hash);
+
+    void Read(Byte* const data, std::size_t size);
+
+   NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+    std::istream& is_;
+
+    std::size_t chunk_ = {0};
+  };
+};
+
+/*
+ * Writes save-state files on a worker thread. Snapshots are taken on the calling thread, which is
+ * then left to run, while the worker compresses them, writes them out and syncs them to the disk.
+ * Files are written to a temporary file first and renamed once synced, so that a file is either
+ * the previous or the new one should the process crash. Errors on the worker are rethrown by the
+ * next call.
+ */
+class SnapshotWriter final {
+ public:
+  SnapshotWriter();
+
+  /*
+   * Writes out the files queued so far before returning, errors left unreported.
+   */
+  ~SnapshotWriter();
+
+  /*
+   * Takes a snapshot of the specified NES and queues it to be written to the specified path.
+   */
+  template <typename NES>
+  void Write(const std::string& path, NES* const nes) {
+    Job job = Acquire();
+    job.path     = path;
+    job.rom_hash = nes->rom->Hash();
+    nes->SaveState([&job](const Byte* const data, std::size_t size) {
+      if (size > 0) job.data.insert(job.data.end(), data, data + size);
+      job.sizes.push_back(size);
+    });
+    Enqueue(std::move(job));
+  }
+
+  /*
+   * Waits until the files queued so far get synced.
+   */
+  void Flush();
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  struct Job {
+    std::string path;
+
+    std::uint64_t rom_hash;
+
+    std::vector<Byte> data;
+
+    std::vector<std::size_t> sizes;
+  };
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  /*
+   * Buffers of the jobs done get recycled, so that checkpointing does not allocate once warmed up.
+   */
+  Job Acquire();
+
+  void Enqueue(Job job);
+
+  void Run();
+
+  void Persist(const Job& job);
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  std::deque<Job> queue_;
+
+  std::vector<Job> free_;
+
+  std::vector<Byte> compressed_;
+
+  bool busy_ = false;
+
+  bool stop_ = false;
+
+  std::exception_ptr error_;
+
+  std::mutex mutex_;
+
+  std::condition_variable ready_;
+
+  std::condition_variable idle_;
+
+  std::thread worker_;
+};
+
+}  // namespace core
+}  // namespace nesdev
+#endif  // ifndef _NESDEV_CORE_SNAPSHOT_H_
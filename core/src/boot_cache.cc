@@ -0,0 +1,41 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cinttypes>
+#include <cstdio>
+#include <utility>
+#include "nesdev/core/boot_cache.h"
+#include "nesdev/core/exceptions.h"
+
+namespace nesdev {
+namespace core {
+
+BootCache::BootCache(std::string directory, std::size_t frames)
+  : directory_{std::move(directory)},
+    frames_{frames} {
+  if (frames == 0)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Invalid number of frames specified to nesdev::core::BootCache"));
+}
+
+void BootCache::Flush() {
+  const std::exception_ptr error = std::exchange(error_, nullptr);
+  try {
+    writer_.Flush();
+  } catch (const InvalidOperation&) {
+    // The errors of the files written earlier come first.
+    if (!error) throw;
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+std::string BootCache::PathOf(std::uint64_t rom_hash) const {
+  char name[64];
+  std::snprintf(name, sizeof(name), "%016" PRIx64 "-r%u-v%u-f%zu.ness", rom_hash, kRevision, Snapshot::kVersion, frames_);
+  return directory_ + "/" + name;
+}
+
+}  // namespace core
+}  // namespace nesdev
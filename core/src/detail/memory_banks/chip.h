@@ -7,6 +7,8 @@
 #ifndef _NESDEV_CORE_DETAIL_MEMORY_BANKS_CHIP_H_
 #define _NESDEV_CORE_DETAIL_MEMORY_BANKS_CHIP_H_
 #include <cstddef>
+#include <memory>
+#include <utility>
 #include <vector>
 #include "nesdev/core/exceptions.h"
 #include "nesdev/core/macros.h"
@@ -26,9 +28,21 @@ class Chip final : public MemoryBank {
     "Start address must be greater than end address");
 
  public:
-  Chip(std::size_t size) {
+  Chip(std::size_t size)
+    : storage_{std::make_shared<std::vector<Byte>>(size)},
+      data_{storage_->data()},
+      size_{size} {
     NESDEV_CORE_CASSERT((To - From + 1u) % size == 0, "Size does not match address range");
-    data_.resize(size);
+  }
+
+  /*
+   * Another chip sharing the contents of this one, either of which copies them once written, so
+   * that forks of a machine share the cartridge until they diverge.
+   */
+  [[nodiscard]]
+  std::unique_ptr<Chip> Share() const {
+    shared_ = true;
+    return std::unique_ptr<Chip>(new Chip(*this));
   }
 
   [[nodiscard]]
@@ -43,20 +57,29 @@ class Chip final : public MemoryBank {
   }
 
   void Write(Address address, Byte byte) override {
-    if (HasValidAddress(address)) *PtrTo(address) = byte;
+    if (HasValidAddress(address)) {
+      if (shared_) Detach();
+      *PtrTo(address) = byte;
+    }
     else NESDEV_CORE_THROW(InvalidAddress::Occur("Invalid address specified to nesdev::core::detail::memory_banks::Chip::Write", address));
   }
 
   std::size_t Size() const override {
-    return data_.size();
+    return size_;
   }
 
   Byte* Data() override {
-    return const_cast<Byte*>(std::as_const(*this).Data());
+    if (shared_) Detach();
+    return data_;
   }
 
   const Byte* Data() const override {
-    return data_.data();
+    return data_;
+  }
+
+  const Byte* PageAt(Address address) const override {
+    if (HasValidAddress(address) && Size() % 0x0400 == 0) return PtrTo(address & ~0x03FF);
+    else return nullptr;
   }
 
  NESDEV_CORE_PRIVATE_UNLESS_TESTED:
@@ -65,11 +88,28 @@ class Chip final : public MemoryBank {
   }
 
   const Byte* PtrTo(Address address) const {
-    return &data_.data()[address % Size()];
+    return &data_[address % size_];
+  }
+
+  Chip(const Chip&) = default;
+
+  void Detach() {
+    if (storage_.use_count() > 1) {
+      storage_ = std::make_shared<std::vector<Byte>>(*storage_);
+      data_    = storage_->data();
+    }
+    shared_ = false;
   }
 
  NESDEV_CORE_PRIVATE_UNLESS_TESTED:
-  std::vector<Byte> data_;
+  std::shared_ptr<std::vector<Byte>> storage_;
+
+  Byte* data_;
+
+  std::size_t size_;
+
+  // Whether the contents may be shared, checked before writes rather than the reference count.
+  mutable bool shared_ = false;
 };
 
 }  // namespace memory_banks
@@ -38,6 +38,15 @@ void MMU::Write(Address address, Byte byte) {
   if (MemoryBank* memory_bank = Switch(address)) return memory_bank->Write(address, byte);
 }
 
+const Byte* MMU::PageAt(Address address) const {
+  if (const MemoryBank* memory_bank = Switch(address)) return memory_bank->PageAt(address);
+  else return nullptr;
+}
+
+MemoryBank* MMU::BankAt(Address address) const {
+  return Switch(address);
+}
+
 MemoryBank* MMU::Switch(Address address) const {
   auto it = std::find_if(
     begin(memory_banks_),
@@ -27,6 +27,10 @@ class MMU final : public nesdev::core::MMU {
 
   void Write(Address address, Byte byte) override;
 
+  const Byte* PageAt(Address address) const override;
+
+  MemoryBank* BankAt(Address address) const override;
+
  NESDEV_CORE_PRIVATE_UNLESS_TESTED:
   MemoryBank* Switch(Address address) const;
 
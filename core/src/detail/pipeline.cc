@@ -13,19 +13,22 @@ namespace nesdev {
 namespace core {
 namespace detail {
 
-void Pipeline::Push(const std::function<void()>& step) {
+void Pipeline::Push(const std::function<void()>& step, Tag tag) {
   steps_.emplace_back([step] {
     step();
     return Status::Continue;
   });
+  tags_.push_back(tag);
 }
 
-void Pipeline::Push(const Step& step) {
+void Pipeline::Push(const Step& step, Tag tag) {
   steps_.push_back(std::move(step));
+  tags_.push_back(tag);
 }
 
 void Pipeline::Append(const Pipeline& other) {
   std::copy(other.steps_.begin(), other.steps_.end(), std::back_inserter(steps_));
+  std::copy(other.tags_.begin(), other.tags_.end(), std::back_inserter(tags_));
 }
 
 bool Pipeline::Done() const {
@@ -36,6 +39,7 @@ void Pipeline::Clear() {
   while (!steps_.empty()) {
     steps_.pop_front();
   }
+  tags_.clear();
   status_ = Status::Continue;
 }
 
@@ -43,6 +47,7 @@ void Pipeline::Tick() {
   if (!steps_.empty()) {
     status_ = steps_.front()();
     steps_.pop_front();
+    tags_.pop_front();
     if (status_ == Status::Skip) Tick();
   }
 }
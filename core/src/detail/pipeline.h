@@ -6,6 +6,7 @@
  */
 #ifndef _NESDEV_CORE_DETAIL_PIPELINE_H_
 #define _NESDEV_CORE_DETAIL_PIPELINE_H_
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include "nesdev/core/macros.h"
@@ -20,11 +21,17 @@ class Pipeline final {
 
   using Step = std::function<Status()>;
 
+  /*
+   * Identifies where each step has been staged from, so that the steps left may be told as
+   * plain data and staged again, e.g., when restoring snapshots.
+   */
+  using Tag = std::uint16_t;
+
   Pipeline() = default;
 
-  void Push(const std::function<void()>& step);
+  void Push(const std::function<void()>& step, Tag tag = 0);
 
-  void Push(const Step& step);
+  void Push(const Step& step, Tag tag = 0);
 
   void Append(const Pipeline& other);
 
@@ -34,10 +41,29 @@ class Pipeline final {
 
   void Tick();
 
+  [[nodiscard]]
+  const std::deque<Tag>& Tags() const {
+    return tags_;
+  }
+
+  /*
+   * The status the last step has returned.
+   */
+  [[nodiscard]]
+  Status Last() const {
+    return status_;
+  }
+
+  void Last(Status status) {
+    status_ = status;
+  }
+
  NESDEV_CORE_PRIVATE_UNLESS_TESTED:
   Status status_ = Status::Continue;
 
   std::deque<Step> steps_ = {};
+
+  std::deque<Tag> tags_ = {};
 };
 
 }  // namespace detail
@@ -0,0 +1,114 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <utility>
+#include "detail/ppu_worker.h"
+
+namespace nesdev {
+namespace core {
+namespace detail {
+
+PPUWorker::PPUWorker(PPU* const ppu, PPU::Registers* const registers)
+  : ppu_{ppu},
+    registers_{registers} {
+  worker_ = std::thread(&PPUWorker::Loop, this);
+}
+
+PPUWorker::~PPUWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  worker_.join();
+}
+
+void PPUWorker::Run(std::size_t dots) {
+  Post({dots, Command::Kind::RUN, 0x0000, 0x00});
+}
+
+void PPUWorker::Write(std::size_t dots, Address address, Byte byte, bool verify) {
+  Post({dots, verify ? Command::Kind::VERIFIED_WRITE : Command::Kind::WRITE, address, byte});
+}
+
+void PPUWorker::WriteOAM(std::size_t dots, Byte address, Byte byte) {
+  Post({dots, Command::Kind::OAM, address, byte});
+}
+
+bool PPUWorker::Wait() {
+  while (!IsIdle()) std::this_thread::yield();
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+  return !halted_;
+}
+
+void PPUWorker::Resume() {
+  halted_ = false;
+}
+
+void PPUWorker::Post(const Command& command) {
+  const std::uint64_t posted = posted_.load(std::memory_order_relaxed);
+  while (posted - completed_.load(std::memory_order_acquire) >= kCapacity) std::this_thread::yield();
+  commands_[posted % kCapacity] = command;
+  posted_.store(posted + 1);
+  // Sequentially consistent along with the worker going to sleep, so that either sees the other.
+  if (sleeping_.load()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_.notify_one();
+  }
+}
+
+void PPUWorker::Loop() {
+  std::uint64_t completed = 0;
+  while (true) {
+    std::uint64_t posted = posted_.load(std::memory_order_acquire);
+    for (std::size_t spin = 0; posted == completed && spin < kSpins && !stop_; spin++) {
+      std::this_thread::yield();
+      posted = posted_.load(std::memory_order_acquire);
+    }
+    if (posted == completed) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      sleeping_ = true;
+      wake_.wait(lock, [this, completed]() { return stop_ || posted_.load() != completed; });
+      sleeping_ = false;
+      if (stop_) return;
+      continue;
+    }
+    for (; completed < posted; completed++) {
+      Execute(commands_[completed % kCapacity]);
+      completed_.store(completed + 1, std::memory_order_release);
+    }
+  }
+}
+
+void PPUWorker::Execute(const Command& command) {
+  if (halted_) return;
+  try {
+    if (command.dots > 0) ppu_->Run(command.dots);
+    switch (command.kind) {
+    case Command::Kind::WRITE:
+      ppu_->Write(command.address, command.byte);
+      break;
+    case Command::Kind::VERIFIED_WRITE: {
+      const bool nmi = IsNMI();
+      ppu_->Write(command.address, command.byte);
+      halted_ = !nmi && IsNMI();
+      break;
+    }
+    case Command::Kind::OAM:
+      ppu_->WriteOAM(static_cast<Byte>(command.address), command.byte);
+      break;
+    default:
+      break;
+    }
+  } catch (...) {
+    error_  = std::current_exception();
+    halted_ = true;
+  }
+}
+
+}  // namespace detail
+}  // namespace core
+}  // namespace nesdev
@@ -0,0 +1,128 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#ifndef _NESDEV_CORE_DETAIL_PPU_WORKER_H_
+#define _NESDEV_CORE_DETAIL_PPU_WORKER_H_
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "nesdev/core/macros.h"
+#include "nesdev/core/ppu.h"
+#include "nesdev/core/types.h"
+
+namespace nesdev {
+namespace core {
+namespace detail {
+
+/*
+ * Runs the PPU on a thread of its own, so that the CPU may run on meanwhile. The CPU posts the
+ * dots to run and the writes to apply, in order, through a ring the worker drains, and waits for
+ * the worker to get idle whenever it needs the PPU as of now.
+ *
+ * Writes may be posted as verified, i.e., speculated not to raise the NMI line. Once one does,
+ * the worker halts, dropping whatever comes next, until the CPU rolls back and resumes it.
+ */
+class PPUWorker final {
+ public:
+  PPUWorker(PPU* const ppu, PPU::Registers* const registers);
+
+  ~PPUWorker();
+
+  void Run(std::size_t dots);
+
+  /*
+   * Runs the specified number of dots, then writes the specified register.
+   */
+  void Write(std::size_t dots, Address address, Byte byte, bool verify);
+
+  void WriteOAM(std::size_t dots, Byte address, Byte byte);
+
+  [[nodiscard]]
+  bool IsIdle() const {
+    return completed_.load(std::memory_order_acquire) == posted_.load(std::memory_order_relaxed);
+  }
+
+  /*
+   * Waits until everything posted has been taken, returning false if halted. Rethrows whatever
+   * the PPU has thrown on the worker.
+   */
+  bool Wait();
+
+  /*
+   * Takes what gets posted from then on again. Supposed to be called once idle.
+   */
+  void Resume();
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  struct Command {
+    enum class Kind : Byte {
+      RUN,
+      WRITE,
+      VERIFIED_WRITE,
+      OAM
+    };
+
+    std::size_t dots;
+
+    Kind kind;
+
+    Address address;
+
+    Byte byte;
+  };
+
+  static constexpr std::size_t kCapacity = 1024;
+
+  // The number of times the worker yields looking for commands before going to sleep.
+  static constexpr std::size_t kSpins = 1 << 12;
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  void Post(const Command& command);
+
+  void Loop();
+
+  void Execute(const Command& command);
+
+  bool IsNMI() const {
+    return registers_->ppustatus.vblank_start && registers_->ppuctrl.nmi_enable;
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  PPU* const ppu_;
+
+  PPU::Registers* const registers_;
+
+  std::array<Command, kCapacity> commands_ = {};
+
+  std::atomic<std::uint64_t> posted_ = {0};
+
+  std::atomic<std::uint64_t> completed_ = {0};
+
+  // Touched by the worker while busy, and by the CPU while idle only.
+  bool halted_ = false;
+
+  std::exception_ptr error_;
+
+  std::atomic<bool> sleeping_ = {false};
+
+  std::atomic<bool> stop_ = {false};
+
+  std::mutex mutex_;
+
+  std::condition_variable wake_;
+
+  std::thread worker_;
+};
+
+}  // namespace detail
+}  // namespace core
+}  // namespace nesdev
+#endif  // ifndef _NESDEV_CORE_DETAIL_PPU_WORKER_H_
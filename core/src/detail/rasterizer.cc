@@ -0,0 +1,168 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include "nesdev/core/memory_bank.h"
+#include "nesdev/core/mmu_factory.h"
+#include "nesdev/core/ppu.h"
+#include "nesdev/core/rom.h"
+#include "nesdev/core/types.h"
+#include "detail/rasterizer.h"
+#include "detail/rp2c02.h"
+#include "detail/memory_banks/chip.h"
+
+namespace {
+
+using namespace nesdev::core;
+
+MemoryBanks ShadowPPUBus(ROM* const rom) {
+  auto pattern_tables = std::make_unique<detail::memory_banks::Chip<0x0000, 0x1FFF>>(0x2000);
+  for (Address address = 0x0000; address < 0x2000; address++)
+    if (rom->mapper->HasValidAddress(ROM::Mapper::Space::PPU, address))
+      pattern_tables->Write(address, rom->mapper->Read(ROM::Mapper::Space::PPU, address));
+  MemoryBanks banks;
+  banks.push_back(std::move(pattern_tables));                                                            // Pattern Tables
+  banks.push_back(std::make_unique<PPU::Nametables<0x2000, 0x3EFF>>(0x0400, rom->mapper->Mirroring())); // Nametables
+  banks.push_back(std::make_unique<PPU::Palette   <0x3F00, 0x3FFF>>(0x20));                              // Pallete
+  return banks;
+}
+
+}
+
+namespace nesdev {
+namespace core {
+namespace detail {
+
+Rasterizer::Rasterizer(ROM* const rom, const std::vector<Byte>& colours)
+  : rom_{rom},
+    chips_{std::make_unique<PPU::Chips>(std::make_unique<PPU::ObjectAttributeMap<>>())},
+    registers_{std::make_unique<PPU::Registers>()},
+    shifters_{std::make_unique<PPU::Shifters>()},
+    mmu_{MMUFactory::Create(::ShadowPPUBus(rom))},
+    shadow_{std::make_unique<RP2C02>(chips_.get(), registers_.get(), shifters_.get(), mmu_.get(), colours)},
+    nametables_{static_cast<PPU::Nametables<0x2000, 0x3EFF>*>(mmu_->BankAt(0x2000))},
+    framebuffer_(PPU::kFrameW * PPU::kFrameH) {
+  shadow_->Framebuffer([this](std::int16_t x, std::int16_t y, ARGB argb) {
+    framebuffer_[y * PPU::kFrameW + x] = argb;
+  });
+  // Notified on the timing core's thread, hence logged as any other change.
+  rom_->mapper->OnMirroringChanged([this](enum ROM::Header::Mirroring mirroring) {
+    Record(Event::Kind::MIRROR, 0x0000, static_cast<Byte>(mirroring));
+  });
+  worker_ = std::thread(&Rasterizer::Run, this);
+}
+
+Rasterizer::~Rasterizer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  ready_.notify_one();
+  worker_.join();
+}
+
+bool Rasterizer::Commit(bool skip_output, const PPU::PixelWriter& pixel_writer) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this]() { return !pending_; });
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+  const bool unchanged = composed_ && unchanged_;
+  if (composed_ && !unchanged && pixel_writer) {
+    for (std::int16_t y = 0; y < PPU::kFrameH; y++)
+      for (std::int16_t x = 0; x < PPU::kFrameW; x++)
+        pixel_writer(x, y, framebuffer_[y * PPU::kFrameW + x]);
+  }
+  std::swap(log_, pending_log_);
+  log_.clear();
+  pending_until_       = dot_;
+  pending_skip_output_ = skip_output;
+  pending_             = true;
+  composed_            = false;
+  lock.unlock();
+  ready_.notify_one();
+  return unchanged;
+}
+
+void Rasterizer::Restore(const PPU::State& state, const MMU& bus, const PPU::ObjectAttributeMap<>& oam) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this]() { return !pending_; });
+  log_.clear();
+  composed_   = false;
+  shadow_dot_ = dot_;
+  for (Address address : {0x2000, 0x3F00}) {
+    const auto* const from = bus.BankAt(address);
+    auto* const to = mmu_->BankAt(address);
+    std::copy_n(std::as_const(*from).Data(), from->Size(), to->Data());
+  }
+  // Pattern tables are taken over page by page too, since CHR-RAM gets restored and cartridges
+  // get swapped in place.
+  const auto* const cartridge = bus.BankAt(0x0000);
+  auto* const patterns = mmu_->BankAt(0x0000);
+  for (Address address = 0x0000; address < 0x2000; address += 0x0400) {
+    if (const auto* const page = cartridge->PageAt(address)) {
+      std::copy_n(page, 0x0400, patterns->Data() + address);
+      continue;
+    }
+    for (Address offset = address; offset < address + 0x0400; offset++)
+      if (cartridge->HasValidAddress(offset)) patterns->Write(offset, cartridge->Read(offset));
+  }
+  for (Address address = 0x00; address < 0x100; address++) chips_->oam->Write(address, oam.Read(address));
+  nametables_->Mirror(rom_->mapper->Mirroring());
+  shadow_->Load(state);
+}
+
+void Rasterizer::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this]() { return !pending_; });
+}
+
+void Rasterizer::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_.wait(lock, [this]() { return pending_ || stop_; });
+    if (stop_) return;
+    // The pending log is left untouched by the timing core until the worker gets idle.
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      shadow_->SkipOutput(pending_skip_output_);
+      Replay(pending_log_, pending_until_);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    error_    = error;
+    composed_  = !pending_skip_output_ && !error;
+    unchanged_ = shadow_->IsFrameUnchanged();
+    pending_  = false;
+    idle_.notify_one();
+  }
+}
+
+void Rasterizer::Replay(const std::vector<Event>& log, std::uint64_t until) {
+  // The shadow is never connected, so its pages are resolved per frame on the worker.
+  shadow_->Remap();
+  for (const auto& event : log) {
+    if (shadow_dot_ < event.dot) shadow_->Run(event.dot - shadow_dot_);
+    shadow_dot_ = event.dot;
+    switch (event.kind) {
+    case Event::Kind::READ:  shadow_->Read(event.address);                                     break;
+    case Event::Kind::WRITE: shadow_->Write(event.address, event.byte);                        break;
+    case Event::Kind::OAM:   shadow_->WriteOAM(static_cast<Byte>(event.address), event.byte); break;
+    case Event::Kind::MIRROR:
+      nametables_->Mirror(static_cast<enum ROM::Header::Mirroring>(event.byte));
+      shadow_->Remap();
+      break;
+    }
+  }
+  if (shadow_dot_ < until) shadow_->Run(until - shadow_dot_);
+  shadow_dot_ = until;
+}
+
+}  // namespace detail
+}  // namespace core
+}  // namespace nesdev
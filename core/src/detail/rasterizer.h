@@ -0,0 +1,145 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#ifndef _NESDEV_CORE_DETAIL_RASTERIZER_H_
+#define _NESDEV_CORE_DETAIL_RASTERIZER_H_
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "nesdev/core/macros.h"
+#include "nesdev/core/mmu.h"
+#include "nesdev/core/ppu.h"
+#include "nesdev/core/rom.h"
+#include "nesdev/core/types.h"
+
+namespace nesdev {
+namespace core {
+namespace detail {
+
+class RP2C02;
+
+/*
+ * Composes pixels on a worker thread. The timing core records every PPU-visible state change,
+ * i.e., register accesses, OAM DMA writes and mirroring switches, stamped with the dot it has
+ * happened at. At the end of each frame the log is handed to the worker, which replays it
+ * against a shadow PPU of its own, so that the shadow reproduces the very same VRAM, palette, OAM
+ * and scroll state at the very same dots, and rasterizes the frame.
+ *
+ * The shadow owns a copy of the nametables, palette RAM and pattern tables, the latter taken
+ * from the mapper at construction, and neither notifies the mapper nor gets notified by it;
+ * nothing but the log is shared between the threads.
+ */
+class Rasterizer final {
+ public:
+  struct Event {
+    enum class Kind : Byte {
+      READ,
+      WRITE,
+      OAM,
+      MIRROR
+    };
+
+    std::uint64_t dot;
+
+    Kind kind;
+
+    Address address;
+
+    Byte byte;
+  };
+
+ public:
+  Rasterizer(ROM* const rom, const std::vector<Byte>& colours);
+
+  ~Rasterizer();
+
+  void Ticked(std::uint64_t dots = 1) {
+    dot_ += dots;
+  }
+
+  void Record(Event::Kind kind, Address address, Byte byte) {
+    log_.push_back({dot_, kind, address, byte});
+  }
+
+  /*
+   * Hands the frame recorded so far to the worker. The frame rasterized previously is delivered
+   * to the specified writer beforehand, so that pixels arrive one frame late and always on the
+   * calling thread. Returns true if the delivered frame is left unchanged, i.e., not written.
+   */
+  bool Commit(bool skip_output, const PPU::PixelWriter& pixel_writer);
+
+  /*
+   * Brings the shadow to the specified state, which the timing core has been restored to along
+   * with the specified bus and OAM. The frames recorded or composed so far are thrown away.
+   */
+  void Restore(const PPU::State& state, const MMU& bus, const PPU::ObjectAttributeMap<>& oam);
+
+  /*
+   * Waits for the frame handed over to be composed.
+   */
+  void Wait();
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  void Run();
+
+  void Replay(const std::vector<Event>& log, std::uint64_t until);
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  ROM* const rom_;
+
+  const std::unique_ptr<PPU::Chips> chips_;
+
+  const std::unique_ptr<PPU::Registers> registers_;
+
+  const std::unique_ptr<PPU::Shifters> shifters_;
+
+  const std::unique_ptr<MMU> mmu_;
+
+  const std::unique_ptr<RP2C02> shadow_;
+
+  PPU::Nametables<0x2000, 0x3EFF>* const nametables_;
+
+  std::uint64_t dot_ = {0};
+
+  std::uint64_t shadow_dot_ = {0};
+
+  std::vector<Event> log_;
+
+  std::vector<Event> pending_log_;
+
+  std::uint64_t pending_until_ = {0};
+
+  bool pending_skip_output_ = false;
+
+  bool pending_ = false;
+
+  bool composed_ = false;
+
+  bool unchanged_ = false;
+
+  bool stop_ = false;
+
+  std::exception_ptr error_;
+
+  std::vector<ARGB> framebuffer_;
+
+  std::mutex mutex_;
+
+  std::condition_variable ready_;
+
+  std::condition_variable idle_;
+
+  std::thread worker_;
+};
+
+}  // namespace detail
+}  // namespace core
+}  // namespace nesdev
+#endif  // ifndef _NESDEV_CORE_DETAIL_RASTERIZER_H_
@@ -6,6 +6,7 @@
  */
 #ifndef _NESDEV_CORE_DETAIL_ROMS_MAPPER000_H_
 #define _NESDEV_CORE_DETAIL_ROMS_MAPPER000_H_
+#include <utility>
 #include "nesdev/core/exceptions.h"
 #include "nesdev/core/macros.h"
 #include "nesdev/core/rom.h"
@@ -58,22 +59,20 @@ class Mapper000 final : public ROM::Mapper {
   void Write(ROM::Mapper::Space space, Address address, Byte byte) const override {
     switch (space) {
     case ROM::Mapper::Space::CPU:
-      if (chips_->prg_rom->HasValidAddress(address)) {
-        chips_->prg_rom->Write(address, byte);        
-        return;                                       
-      }                                               
+      // PRG-ROM ignores writes, there being no registers to write to on NROM.
+      if (chips_->prg_rom->HasValidAddress(address)) return;
       if (chips_->prg_ram->HasValidAddress(address)) {
-        chips_->prg_ram->Write(address, byte);
+        WriteThrough(chips_->prg_ram.get(), address, byte);
         return;
       }
       [[fallthrough]];
     case ROM::Mapper::Space::PPU:
       if (chips_->chr_rom->HasValidAddress(address)) {
-        chips_->chr_rom->Write(address, byte);        
-        return;                                       
-      }                                               
+        WriteThrough(chips_->chr_rom.get(), address, byte);
+        return;
+      }
       if (chips_->chr_ram->HasValidAddress(address)) {
-        chips_->chr_ram->Write(address, byte);
+        WriteThrough(chips_->chr_ram.get(), address, byte);
         return;
       }
       [[fallthrough]];
@@ -85,6 +84,26 @@ class Mapper000 final : public ROM::Mapper {
     }
   }
 
+  [[nodiscard]]
+  const Byte* PageAt(ROM::Mapper::Space space, Address address) const override {
+    switch (space) {
+    case ROM::Mapper::Space::CPU:
+      if (chips_->prg_ram->HasValidAddress(address))
+        return chips_->prg_ram->PageAt(address);
+      if (chips_->prg_rom->HasValidAddress(address))
+        return chips_->prg_rom->PageAt(address);
+      return nullptr;
+    case ROM::Mapper::Space::PPU:
+      if (chips_->chr_ram->HasValidAddress(address))
+        return chips_->chr_ram->PageAt(address);
+      if (chips_->chr_rom->HasValidAddress(address))
+        return chips_->chr_rom->PageAt(address);
+      return nullptr;
+    default:
+      NESDEV_CORE_THROW(InvalidAddress::Occur("Invalid address space specified to nesdev::core::detail::roms::Mapper000::PageAt", address));
+    }
+  }
+
   [[nodiscard]]
   bool IRQ() const override {
     return false;
@@ -98,9 +117,29 @@ class Mapper000 final : public ROM::Mapper {
     // Do nothing.
   }
 
+  [[nodiscard]]
+  bool CountsScanlines() const override {
+    return false;
+  }
+
   void Reset() override {
     // Do nothing.
   }
+
+  [[nodiscard]]
+  enum ROM::Header::Mirroring Mirroring() const override {
+    return header_->Mirroring();
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  /*
+   * Chips shared with forks get copied once written, which moves the pages they have handed out.
+   */
+  void WriteThrough(MemoryBank* const chip, Address address, Byte byte) const {
+    const Byte* const data = std::as_const(*chip).Data();
+    chip->Write(address, byte);
+    if (std::as_const(*chip).Data() != data) BanksSwitched();
+  }
 };
 
 }  // namespace roms
@@ -6,6 +6,7 @@
  */
 #ifndef _NESDEV_CORE_DETAIL_ROMS_NROM_H_
 #define _NESDEV_CORE_DETAIL_ROMS_NROM_H_
+#include <cstdint>
 #include <memory>
 #include "nesdev/core/rom.h"
 
@@ -22,6 +23,15 @@ class NROM final : public ROM {
     : ROM{std::move(header),
           std::move(chips),
           std::move(mapper)} {}
+
+  NROM(std::unique_ptr<ROM::Header> header,
+       std::unique_ptr<ROM::Chips> chips,
+       std::unique_ptr<ROM::Mapper> mapper,
+       std::uint64_t hash)
+    : ROM{std::move(header),
+          std::move(chips),
+          std::move(mapper),
+          hash} {}
 };
 
 }  // namespace roms
@@ -4,6 +4,8 @@
  * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
  * Trademarks are owned by their respect owners.
  */
+#include <algorithm>
+#include <cstring>
 #include "nesdev/core/cpu.h"
 #include "nesdev/core/exceptions.h"
 #include "nesdev/core/macros.h"
@@ -58,6 +60,11 @@ void RP2A03::Tick() {
 void RP2A03::Next() {
   // Parse next instruction.
   Parse();
+  Decode();
+}
+
+void RP2A03::Decode() {
+  Stage(Source::NEXT);
   // Stage the specified addressing mode.
   switch (AddrMode()) {
   case A::ACC:
@@ -371,6 +378,7 @@ bool RP2A03::IsIdle() const {
 }
 
 void RP2A03::Reset() {
+  Stage(Source::RESET);
   Stage([this] { AddrLo(Read(RP2A03::kRSTAddress));                       });
   Stage([this] { AddrHi(Read(RP2A03::kRSTAddress + 1)); REG(pc) = Addr(); });
   Stage([this] { REG(a) = 0x00;                                           });
@@ -381,6 +389,7 @@ void RP2A03::Reset() {
 }
 
 void RP2A03::IRQ() {
+  Stage(Source::IRQ);
   Stage([this] { Push(REG_HI(pc));                                                      }, IfNotIRQDisable());
   Stage([this] { Push(REG_LO(pc));                                                      }, IfNotIRQDisable());
   Stage([this] { REG(p) |= MSK(unused) | MSK(irq_disable); REG(p) &= ~MSK(brk_command); }, IfNotIRQDisable());
@@ -390,6 +399,7 @@ void RP2A03::IRQ() {
 }
 
 void RP2A03::NMI() {
+  Stage(Source::NMI);
   Stage([this] { Read(REG(pc));                                                                       });
   Stage([this] { Push(REG_HI(pc));                                                                    });
   Stage([this] { Push(REG_LO(pc));                                                                    });
@@ -397,7 +407,61 @@ void RP2A03::NMI() {
   Stage([this] { AddrLo(Read(RP2A03::kNMIAddress));                                                   });
   Stage([this] { AddrHi(Read(RP2A03::kNMIAddress + 1)); REG(pc) = Addr();                             });
 }
-  
+
+void RP2A03::Save(CPU::State* const state) const {
+  const auto& tags = pipeline_.Tags();
+  if (tags.size() > CPU::State::kMaxSteps)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Too many steps staged to save nesdev::core::detail::RP2A03"));
+  state->registers = *registers_;
+  // Copied field by field onto zeros, since the padding and a disengaged opcode keep whatever
+  // they held last, which would make it to snapshots as is.
+  std::memset(static_cast<void*>(&state->context), 0, sizeof(state->context));
+  state->context.cycle             = context_.cycle;
+  state->context.fetched           = context_.fetched;
+  state->context.opcode_byte       = context_.opcode_byte;
+  if (context_.opcode) state->context.opcode.emplace(*context_.opcode);
+  state->context.is_page_crossed   = context_.is_page_crossed;
+  state->context.address.effective = context_.address.effective;
+  state->context.pointer.effective = context_.pointer.effective;
+  state->status    = static_cast<Byte>(pipeline_.Last());
+  state->num_steps = static_cast<Byte>(tags.size());
+  std::copy(tags.begin(), tags.end(), state->steps);
+}
+
+void RP2A03::Load(const CPU::State& state) {
+  if (state.num_steps > CPU::State::kMaxSteps)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Too many steps staged to load nesdev::core::detail::RP2A03"));
+  if (state.status > static_cast<Byte>(Pipeline::Status::Stop))
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Invalid status specified to load nesdev::core::detail::RP2A03"));
+  // Steps of instructions get staged from the opcode, which must be in flight then.
+  for (std::size_t step = 0; step < state.num_steps; step++) {
+    const auto source = state.steps[step] >> 8;
+    if (source > static_cast<Pipeline::Tag>(Source::NMI) || (source == static_cast<Pipeline::Tag>(Source::NEXT) && !state.context.opcode))
+      NESDEV_CORE_THROW(InvalidOperation::Occur("Invalid steps specified to load nesdev::core::detail::RP2A03"));
+  }
+  *registers_ = state.registers;
+  context_    = state.context;
+  pipeline_.Clear();
+  for (std::size_t step = 0; step < state.num_steps; step++) Restage(state.steps[step]);
+  pipeline_.Last(static_cast<Pipeline::Status>(state.status));
+}
+
+/*
+ * Steps are told by their order within the sources, which stage them from the registers and the
+ * context restored beforehand. Conditions evaluated at staging time are ignored here, as they
+ * have been evaluated once the step got staged originally.
+ */
+void RP2A03::Restage(Pipeline::Tag tag) {
+  restaging_ = tag;
+  switch (static_cast<Source>(tag >> 8)) {
+  case Source::NEXT:  Decode(); break;
+  case Source::RESET: Reset();  break;
+  case Source::IRQ:   IRQ();    break;
+  case Source::NMI:   NMI();    break;
+  }
+  restaging_.reset();
+}
+
 }  // namespace detail
 }  // namespace core
 }  // namespace nesdev
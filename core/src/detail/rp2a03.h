@@ -9,6 +9,7 @@
 #include <iostream>
 #include <cstdint>
 #include <functional>
+#include <optional>
 #include "nesdev/core/cpu.h"
 #include "nesdev/core/macros.h"
 #include "nesdev/core/mmu.h"
@@ -45,6 +46,10 @@ class RP2A03 final : public CPU {
 
   void NMI() override;
 
+  void Save(CPU::State* const state) const override;
+
+  void Load(const CPU::State& state) override;
+
   Address PCRegister() const override {
     return registers_->pc.value;
   }
@@ -233,10 +238,34 @@ class RP2A03 final : public CPU {
     // This is just for formatting the code.
   }
 
+  /*
+   * Where steps get staged from. Each step is tagged with its source along with its order among
+   * the steps the source may stage, whether or not it has been staged.
+   */
+  enum class Source : Byte {
+    NEXT,
+    RESET,
+    IRQ,
+    NMI
+  };
+
+  void Stage(Source source) {
+    staging_ = static_cast<Pipeline::Tag>(static_cast<Pipeline::Tag>(source) << 8);
+  }
+
   void Stage(const std::function<void()>& step, bool when=true) {
-    if (when) pipeline_.Push(step);
+    const auto tag = staging_++;
+    if (restaging_ ? *restaging_ == tag : when) pipeline_.Push(step, tag);
   }
 
+  /*
+   * Stages the very step the specified tag tells, regardless of the conditions it has been staged
+   * on, which may no longer hold.
+   */
+  void Restage(Pipeline::Tag tag);
+
+  void Decode();
+
   [[nodiscard]]
   bool ClearWhenCompleted() {
     if (pipeline_.Done()) {
@@ -432,6 +461,10 @@ class RP2A03 final : public CPU {
   ALU alu_;
 
   Pipeline pipeline_;
+
+  Pipeline::Tag staging_ = {0};
+
+  std::optional<Pipeline::Tag> restaging_;
 };
 
 }  // namespace detail
@@ -4,6 +4,10 @@
  * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
  * Trademarks are owned by their respect owners.
  */
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
 #include <memory>
 #include "nesdev/core/ppu.h"
 #include "nesdev/core/exceptions.h"
@@ -13,6 +17,107 @@
 #include "detail/rp2c02.h"
 #include "detail/memory_banks/chip.h"
 
+namespace {
+
+using namespace nesdev::core;
+
+/*
+ * Actions taken at each dot. The bits are ordered as the actions are taken within a dot.
+ * [SEE] https://wiki.nesdev.com/w/index.php/PPU_rendering
+ */
+enum Action : std::uint16_t {
+  SKIP_DOT    = 1 <<  0,
+  CLEAR_FLAGS = 1 <<  1,
+  SHIFT       = 1 <<  2,
+  FETCH_ID    = 1 <<  3,
+  FETCH_ATTR  = 1 <<  4,
+  FETCH_LSB   = 1 <<  5,
+  FETCH_MSB   = 1 <<  6,
+  SCROLL_X    = 1 <<  7,
+  SCROLL_Y    = 1 <<  8,
+  TRANSFER_X  = 1 <<  9,
+  FETCH_DUMMY = 1 << 10,
+  TRANSFER_Y  = 1 << 11,
+  EVALUATE_SP = 1 << 12,
+  GATHER_SP   = 1 << 13,
+  SET_VBLANK  = 1 << 14,
+  COMPOSE     = 1 << 15
+};
+
+enum Line : Byte {
+  PRE_RENDER,
+  VISIBLE,
+  VISIBLE_ODD,
+  POST_RENDER,
+  VBLANK,
+  IDLE,
+  NUM_LINES
+};
+
+using Actions = std::array<std::uint16_t, 341>;
+
+constexpr Actions ActionsOf(Line line) {
+  Actions actions = {};
+  for (std::int16_t cycle = 0; cycle < 341; cycle++) {
+    // Pixels outside of these dots are neither written nor able to hit sprite 0.
+    if (cycle >= 1 && cycle < 258) actions[cycle] |= COMPOSE;
+    if (line != PRE_RENDER && line != VISIBLE && line != VISIBLE_ODD) continue;
+    if ((cycle >= 2 && cycle < 258) || (cycle >= 321 && cycle < 338)) {
+      actions[cycle] |= SHIFT;
+      switch ((cycle - 1) % 8) {
+      case 0: actions[cycle] |= FETCH_ID;   break;
+      case 2: actions[cycle] |= FETCH_ATTR; break;
+      case 4: actions[cycle] |= FETCH_LSB;  break;
+      case 6: actions[cycle] |= FETCH_MSB;  break;
+      case 7: actions[cycle] |= SCROLL_X;   break;
+      }
+    }
+    if (cycle == 256)                                     actions[cycle] |= SCROLL_Y;
+    if (cycle == 257)                                     actions[cycle] |= TRANSFER_X;
+    if (cycle == 338 || cycle == 340)                     actions[cycle] |= FETCH_DUMMY;
+    if (cycle >= 280 && cycle < 305 && line == PRE_RENDER) actions[cycle] |= TRANSFER_Y;
+    if (cycle == 257 && line != PRE_RENDER)               actions[cycle] |= EVALUATE_SP;
+    if (cycle == 340 && line != PRE_RENDER)               actions[cycle] |= GATHER_SP;
+  }
+  if (line == PRE_RENDER)  actions[1] |= CLEAR_FLAGS;
+  if (line == VISIBLE_ODD) actions[0] |= SKIP_DOT;
+  if (line == VBLANK)      actions[1] |= SET_VBLANK;
+  return actions;
+}
+
+constexpr std::array<Actions, NUM_LINES> kActions = {
+  ActionsOf(PRE_RENDER),
+  ActionsOf(VISIBLE),
+  ActionsOf(VISIBLE_ODD),
+  ActionsOf(POST_RENDER),
+  ActionsOf(VBLANK),
+  ActionsOf(IDLE)
+};
+
+/*
+ * Maps scanlines, offset by one so as to start from the pre-render line, to the actions to be
+ * taken. The odd frames differ in the first visible line, whose dot 0 is skipped while rendering.
+ */
+constexpr std::array<Line, 262> LinesOf(bool odd_frame) {
+  std::array<Line, 262> lines = {};
+  for (std::int16_t scanline = -1; scanline < 261; scanline++) {
+    if      (scanline == -1)  lines[scanline + 1] = PRE_RENDER;
+    else if (scanline == 0)   lines[scanline + 1] = odd_frame ? VISIBLE_ODD : VISIBLE;
+    else if (scanline < 240)  lines[scanline + 1] = VISIBLE;
+    else if (scanline == 240) lines[scanline + 1] = POST_RENDER;
+    else if (scanline == 241) lines[scanline + 1] = VBLANK;
+    else                      lines[scanline + 1] = IDLE;
+  }
+  return lines;
+}
+
+constexpr std::array<std::array<Line, 262>, 2> kLines = {
+  LinesOf(false),
+  LinesOf(true)
+};
+
+}
+
 namespace nesdev {
 namespace core {
 namespace detail {
@@ -25,18 +130,23 @@ RP2C02::RP2C02(PPU::Chips* const chips,
                PPU::Registers* const registers,
                PPU::Shifters* const shifters,
                MMU* const mmu,
-               const std::vector<Byte>& colours)
+               const std::vector<Byte>& colours,
+               std::unique_ptr<Rasterizer> rasterizer)
   : PPU{colours},
     chips_{std::move(chips)},
     registers_{registers},
     shifters_{shifters},
     mmu_{mmu},
     latch_{registers_, mmu_, chips_},
-    shift_{&context_, &colours_, registers_, shifters, mmu_, chips_} {}
+    shift_{&context_, &colours_, registers_, shifters, mmu_, chips_},
+    rasterizer_{std::move(rasterizer)} {
+  context_.offloaded = rasterizer_ != nullptr;
+}
 
 RP2C02::~RP2C02() {}
 
 Byte RP2C02::Read(Address address) {
+  if (rasterizer_) rasterizer_->Record(Rasterizer::Event::Kind::READ, address, 0x00);
   switch (Map(address)) {
   case MemoryMap::PPUCTRL:   ReadPPUCtrl();   break;
   case MemoryMap::PPUMASK:   ReadPPUMask();   break;
@@ -52,6 +162,10 @@ Byte RP2C02::Read(Address address) {
 }
 
 void RP2C02::Write(Address address, Byte byte) {
+  if (rasterizer_) rasterizer_->Record(Rasterizer::Event::Kind::WRITE, address, byte);
+  prefetched_ = false;
+  const auto inputs   = Inputs();
+  const auto vramaddr = REG(vramaddr);
   switch (Map(address)) {
   case MemoryMap::PPUCTRL:   WritePPUCtrl(byte);   break;
   case MemoryMap::PPUMASK:   WritePPUMask(byte);   break;
@@ -63,6 +177,51 @@ void RP2C02::Write(Address address, Byte byte) {
   case MemoryMap::PPUDATA:   WritePPUData(byte);   break;
   default:                                         break;
   }
+  if (Scanline() < PPU::kFrameH && (inputs != Inputs() || vramaddr != REG(vramaddr))) Alter();
+}
+
+void RP2C02::WriteOAM(Byte address, Byte byte) {
+  if (rasterizer_) rasterizer_->Record(Rasterizer::Event::Kind::OAM, address, byte);
+  if (chips_->oam->Read(address) != byte) Alter();
+  chips_->oam->Write(address, byte);
+}
+
+void RP2C02::Save(PPU::State* const state) const {
+  state->registers   = *registers_;
+  state->shifters    = *shifters_;
+  state->cycle       = context_.cycle;
+  state->scanline    = context_.scanline;
+  state->odd_frame   = context_.odd_frame;
+  state->background  = context_.background;
+  // Entries left over from earlier scanlines are not in use, hence left out.
+  std::fill(std::copy_n(context_.sprite, context_.num_sprites, state->sprite), std::end(state->sprite), PPU::ObjectAttributeMap<>::Entry{});
+  state->num_sprites = context_.num_sprites;
+  state->prefetched  = prefetched_;
+  state->altered     = altered_;
+  state->inputs      = inputs_;
+  latch_.Save(state);
+  shift_.Save(state);
+}
+
+void RP2C02::Load(const PPU::State& state) {
+  *registers_           = state.registers;
+  *shifters_            = state.shifters;
+  context_.cycle        = state.cycle;
+  context_.scanline     = state.scanline;
+  context_.odd_frame    = state.odd_frame;
+  context_.background   = state.background;
+  std::copy(std::begin(state.sprite), std::end(state.sprite), context_.sprite);
+  context_.num_sprites  = state.num_sprites;
+  prefetched_           = state.prefetched;
+  altered_              = state.altered;
+  inputs_               = state.inputs;
+  latch_.Load(state);
+  shift_.Load(state);
+  // The pixel writer holds frames of the timeline left behind.
+  context_.unchanged       = false;
+  context_.presented       = false;
+  context_.frame_unchanged = false;
+  if (rasterizer_) rasterizer_->Restore(state, *mmu_, *chips_->oam);
 }
 
 /*
@@ -70,44 +229,89 @@ void RP2C02::Write(Address address, Byte byte) {
  * [SEE] https://wiki.nesdev.com/w/index.php/PPU_rendering
  */
 void RP2C02::Tick() {
-  if (IsPreRenderOrVisibleLine()) {
+  const auto& line = ::kActions[::kLines[IsOddFrame()][Scanline() + 1]];
+  auto actions = line[Cycle()];
+  if ((actions & ::SKIP_DOT) && IsRendering()) {
+    Cycle(1);
+    actions = line[Cycle()];
+  }
+  const bool fetching = IsFetching();
+  for (actions &= ~::SKIP_DOT; actions != 0; actions &= actions - 1) {
+    switch (actions & -actions) {
     // Flag Operations.
-    if (Scanline() == 0 && Cycle() == 0 && IsOddFrame() && IsRendering()) {
-      Cycle(1);
-    }
-    if (Scanline() == -1 && Cycle() == 1) {
+    case ::CLEAR_FLAGS:
       REG(ppustatus) &= ~(MSK(vblank_start) | MSK(sprite_overflow) | MSK(sprite_zero_hit));
       ClearSp();
-    }
+      break;
     // Background Rendering.
-    if (IsNotIdleCycle()) {
-      UpdateShiftAt(Cycle());
-      switch ((Cycle() - 1) % 8) {
-      case 0: LoadBg(); ReadBgId(); break;
-      case 2: ReadBgAttr();         break;
-      case 4: ReadBgLSB();          break;
-      case 6: ReadBgMSB();          break;
-      case 7: ScrollX();            break;
-      }
-    }
+    case ::SHIFT:       if (fetching) UpdateShift();                        break;
+    case ::FETCH_ID:    if (fetching) { LoadBg(); ReadBgId(); }             break;
+    case ::FETCH_ATTR:  if (fetching) ReadBgAttr();                         break;
+    case ::FETCH_LSB:   if (fetching) ReadBgLSB();                          break;
+    case ::FETCH_MSB:   if (fetching) ReadBgMSB();                          break;
+    case ::SCROLL_X:    ScrollX();                                          break;
     // Callbacks/Preparations.
-    if (IsEndOfVisibleCycle()) { ScrollY();             }
-    if (IsStartOfIdleCycle())  { LoadBg(); TransferX(); }
-    if (IsEndOfScanline(true)) { ReadBgId();            }
-    if (IsEndOfVBlank())       { TransferY();           }
+    case ::SCROLL_Y:    ScrollY();                                          break;
+    case ::TRANSFER_X:  if (fetching) LoadBg(); TransferX();                break;
+    case ::FETCH_DUMMY: if (fetching) ReadBgId();                           break;
+    case ::TRANSFER_Y:  TransferY();                                        break;
     // Foreground Rendering.
-    if (IsStartOfIdleCycle() && Scanline() >= 0) { EvaluateSpAt(Scanline()); }
-    if (IsEndOfScanline(false))                  { GatherSpAt(Scanline());   }
+    case ::EVALUATE_SP: if (IsRendering()) EvaluateSpAt(Scanline());        break;
+    case ::GATHER_SP:   if (IsFetching()) GatherSpAt(Scanline());           break;
+    // Flag Operations.
+    case ::SET_VBLANK:  BIT(ppustatus, vblank_start) |= MSK(vblank_start); break;
+    // Draw Framebuffer.
+    case ::COMPOSE:     if (IsComposing()) ComposeAt(Cycle(), Scanline());  break;
+    }
   }
-  // Flag Operations.
-  if (IsPostRenderLine()) { /* Do nothing. */                                  }
-  if (IsStartOfVBlank())  { BIT(ppustatus, vblank_start) |= MSK(vblank_start); }
-  // Draw Framebuffer.
-  ComposeAt(Cycle(), Scanline());
   // Update Context.
   Ticked();
 }
 
+/*
+ * While rendering is disabled, nothing but the status flags and the backdrop colour is observable,
+ * so that a stretch of dots up to the next flag operation collapses into a single update. While
+ * rendering, the visible dots of a line which no register access falls in are composed at once.
+ */
+void RP2C02::Run(std::size_t dots) {
+  while (dots > 0) {
+    if (IsRendering()) {
+      if (Cycle() == 321) prefetched_ = true;
+      if (Cycle() == 1 && Scanline() >= 0 && Scanline() < PPU::kFrameH && dots >= PPU::kFrameW && IsLayered()) {
+        ComposeLine();
+        dots -= PPU::kFrameW;
+        continue;
+      }
+    }
+    if (IsRendering() || (Cycle() == 1 && (Scanline() == -1 || Scanline() == 241))) {
+      Tick();
+      dots--;
+      continue;
+    }
+    std::int16_t collapsed = std::min<std::size_t>(dots, 341 - Cycle());
+    if ((Scanline() == -1 || Scanline() == 241) && Cycle() < 1) collapsed = 1 - Cycle();
+    if (Scanline() >= 0 && Scanline() < PPU::kFrameH && context_.IsWriting()) {
+      const auto backdrop = Backdrop();
+      for (auto cycle = std::max<std::int16_t>(Cycle(), 1); cycle < std::min<std::int16_t>(Cycle() + collapsed, PPU::kFrameW + 1); cycle++)
+        context_.pixel_writer(cycle - 1, Scanline(), backdrop);
+    }
+    Ticked(collapsed);
+    dots -= collapsed;
+  }
+}
+
+/*
+ * Takes the place of the dots 1-256 of a visible line. The background shifters and latches are
+ * left behind, as they are not observed until the prefetches of the next line refill them.
+ */
+void RP2C02::ComposeLine() {
+  if (IsComposing()) shift_.ComposeLine(Scanline());
+  // Coarse x gets incremented 32 times, hence wraps around to the other nametable.
+  BIT(vramaddr, nametable_x) = !BIT(vramaddr, nametable_x);
+  ScrollY();
+  Ticked(PPU::kFrameW);
+}
+
 }  // namespace detail
 }  // namespace core
 }  // namespace nesdev
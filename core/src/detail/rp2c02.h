@@ -6,16 +6,19 @@
  */
 #ifndef _NESDEV_CORE_DETAIL_RP2C02_H_
 #define _NESDEV_CORE_DETAIL_RP2C02_H_
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <bitset>
 #include <cstdint>
-#include <cstring>
 #include <memory>
+#include <vector>
 #include "nesdev/core/exceptions.h"
 #include "nesdev/core/ppu.h"
 #include "nesdev/core/macros.h"
 #include "nesdev/core/mmu.h"
 #include "nesdev/core/types.h"
+#include "detail/rasterizer.h"
 
 namespace nesdev {
 namespace core {
@@ -27,9 +30,7 @@ namespace detail {
 #define BACK(x)             shifters_->background_##x.value
 #define SHIFT_BACK(x, s)    shifters_->background_##x.shift <<= s
 #define PUSH_BACK(x, s)     shifters_->background_##x.shift(s)
-#define SPRT(x, e)          shifters_->sprite_##x[e].value
-#define SHIFT_SPRT(x, e, s) shifters_->sprite_##x[e].shift <<= s
-#define PUSH_SPRT(x, e, s)  shifters_->sprite_##x[e].shift(s)
+#define SPRT(x)             shifters_->sprite_line[x]
 #define FINE_X              (0x8000 >> REG(fine_x))
 
 class RP2C02 final : public PPU {
@@ -50,16 +51,36 @@ class RP2C02 final : public PPU {
          PPU::Registers* const registers,
          PPU::Shifters* const shifters,
          MMU* const mmu,
-         const std::vector<Byte>& colours);
+         const std::vector<Byte>& colours,
+         std::unique_ptr<Rasterizer> rasterizer = nullptr);
 
   ~RP2C02();
 
   void Tick() override;
 
+  void Run(std::size_t dots) override;
+
+  void Remap() override {
+    if (shift_.Remap()) {
+      prefetched_ = false;
+      Alter();
+    }
+  }
+
+  void Quiesce() override {
+    if (rasterizer_) rasterizer_->Wait();
+  }
+
+  void Save(PPU::State* const state) const override;
+
+  void Load(const PPU::State& state) override;
+
   Byte Read(Address address) override;
 
   void Write(Address address, Byte byte) override;
 
+  void WriteOAM(Byte address, Byte byte) override;
+
   bool IsRendering() const override {
     return BIT(ppumask, background_enable) || BIT(ppumask, sprite_enable);
   }
@@ -96,6 +117,22 @@ class RP2C02 final : public PPU {
     return shifters_->background_attr_hi.value;
   }
 
+  void RenderPatternTable(std::size_t table, Byte palette, ARGB* const pixels) const override {
+    shift_.RenderPatternTable(table, palette, pixels);
+  }
+
+  void RenderNametables(ARGB* const pixels) const override {
+    shift_.RenderNametables(pixels);
+  }
+
+  void RenderSprites(ARGB* const pixels) const override {
+    shift_.RenderSprites(pixels);
+  }
+
+  void RenderPalette(ARGB* const colours) const override {
+    shift_.RenderPalette(colours);
+  }
+
  NESDEV_CORE_PRIVATE_UNLESS_TESTED:
   class Latch {
    public:
@@ -123,6 +160,18 @@ class RP2C02 final : public PPU {
       return deffered_ = byte;
     }
 
+    void Save(PPU::State* const state) const {
+      state->latch      = latch_;
+      state->deffered   = deffered_;
+      state->is_latched = is_latched_;
+    }
+
+    void Load(const PPU::State& state) {
+      latch_      = state.latch;
+      deffered_   = state.deffered;
+      is_latched_ = state.is_latched;
+    }
+
     void ReadPPUCtrl() {
       /* Do nothing. */
     }
@@ -257,25 +306,33 @@ class RP2C02 final : public PPU {
         registers_{registers},
         shifters_{shifters},
         mmu_{mmu},
-        chips_{chips} {}
+        chips_{chips} {
+      // Palette RAM is cleared on power up, so resolve it without going through the bus.
+      palette_.fill(colours_->Get(BIT(ppumask, intensity), 0x00));
+    }
+
+    void Save(PPU::State* const state) const {
+      state->may_sprite_zero_hit  = may_sprite_zero_hit_;
+      state->sprite_zero_rendered = sprite_zero_rendered_;
+    }
 
-    void UpdateAt(std::int16_t cycle) {
+    /*
+     * The caches are rebuilt from scratch, as the memories may have been restored underneath.
+     */
+    void Load(const PPU::State& state) {
+      may_sprite_zero_hit_  = state.may_sprite_zero_hit;
+      sprite_zero_rendered_ = state.sprite_zero_rendered;
+      InvalidateBg();
+      ResolvePalette();
+    }
+
+    void Update() {
       if (BIT(ppumask, background_enable)) {
         SHIFT_BACK(pttr_lo, 1u);
         SHIFT_BACK(pttr_hi, 1u);
         SHIFT_BACK(attr_lo, 1u);
         SHIFT_BACK(attr_hi, 1u);
       }
-      if (BIT(ppumask, sprite_enable) && cycle >= 1 && cycle < 258) {
-        for (std::size_t i = 0; i < context_->num_sprites; i++) {
-          if (context_->sprite[i].x > 0) {
-            context_->sprite[i].x--;
-          } else {
-            SHIFT_SPRT(pttr_lo, i, 1u);
-            SHIFT_SPRT(pttr_hi, i, 1u);
-          }
-        }
-      }
     }
 
     void LoadBg() {
@@ -286,15 +343,15 @@ class RP2C02 final : public PPU {
     }
 
     void ReadBgId() {
-      context_->background.id = mmu_->Read(0x2000 | BIT(vramaddr, tile_id));
+      context_->background.id = Fetch(0x2000 | BIT(vramaddr, tile_id));
     }
 
     void ReadBgAttr() {
-      context_->background.attr = mmu_->Read(0x23C0
-                                             | ( BIT(vramaddr, nametable_y)    << 11)
-                                             | ( BIT(vramaddr, nametable_x)    << 10) 
-                                             | ((BIT(vramaddr, coarse_y) >> 2) <<  3) 
-                                             | ( BIT(vramaddr, coarse_x)       >>  2));
+      context_->background.attr = Fetch(0x23C0
+                                        | ( BIT(vramaddr, nametable_y)    << 11)
+                                        | ( BIT(vramaddr, nametable_x)    << 10) 
+                                        | ((BIT(vramaddr, coarse_y) >> 2) <<  3) 
+                                        | ( BIT(vramaddr, coarse_x)       >>  2));
       // Since we know we can access a tile directly from the 12 bit address, we
       // can analyse the bottom bits of the coarse coordinates to provide us with
       // the correct offset into the 8-bit word, to yield the 2 bits we are
@@ -309,48 +366,35 @@ class RP2C02 final : public PPU {
     }
 
     void ReadBgLSB() {
-      context_->background.lsb = mmu_->Read((BIT(ppuctrl, background_tile) << 12)
-                                   + (context_->background.id << 4)
-                                   + BIT(vramaddr, fine_y));
+      context_->background.lsb = Fetch((BIT(ppuctrl, background_tile) << 12)
+                                       + (context_->background.id << 4)
+                                       + BIT(vramaddr, fine_y));
     }
 
     void ReadBgMSB() {
-      context_->background.msb = mmu_->Read((BIT(ppuctrl, background_tile) << 12)
-                                            + (context_->background.id << 4)
-                                            + BIT(vramaddr, fine_y)
-                                            + 8);
+      context_->background.msb = Fetch((BIT(ppuctrl, background_tile) << 12)
+                                       + (context_->background.id << 4)
+                                       + BIT(vramaddr, fine_y)
+                                       + 8);
     }
 
     void ClearSp() {
-      for (std::size_t entry = 0; entry < PPU::kNumSprites; entry++) {
-        SPRT(pttr_lo, entry) = 0x0000;
-        SPRT(pttr_hi, entry) = 0x0000;
-      }
+      for (std::size_t x = 0; x < PPU::kFrameW; x++) SPRT(x).value = 0x00;
     }
 
     void EvaluateSpAt(std::int16_t scanline) {
-      // Clear sprites scanline with 0xFF, because 0xFF y coordinate is not visible.
-      std::memset(context_->sprite,
-                  0xFF,
-                  PPU::kNumSprites * sizeof(PPU::ObjectAttributeMap<>::Entry));
       context_->num_sprites = 0;
       ClearSp();
       // Populate sprites to be rendered, that is, sprites which "collide" to the scanline.
-      std::size_t entry = 0;
-      may_sprite_zero_hit_ = false;
-      while (entry < chips_->oam->Size() && context_->num_sprites < PPU::kNumSprites + 1) {
-        Byte entry_addr = 4 * entry;
-        // To evaluate "collide", compare y coordinate.
-        std::int16_t diff = scanline - static_cast<std::int16_t>(chips_->oam->Read(entry_addr));
-        if (diff >= 0 && diff < (Is8x8Mode() ? 8 : 16) && context_->num_sprites < PPU::kNumSprites) {
-          std::memcpy(&context_->sprite[context_->num_sprites++],
-                      &chips_->oam->Data()[entry_addr],
-                      sizeof(PPU::ObjectAttributeMap<>::Entry));
-          if (entry == 0) may_sprite_zero_hit_ = true;
-        }
-        entry++;
+      // Collisions are indexed by OAM on each write, so just take the first nine hits in
+      // OAM order; the ninth one only signals the sprite overflow.
+      auto collisions = chips_->oam->CollisionsAt(scanline, Is8x8Mode());
+      may_sprite_zero_hit_ = collisions & 0x01;
+      for (std::size_t entry = 0; collisions != 0 && context_->num_sprites < PPU::kNumSprites; entry++, collisions >>= 1) {
+        if (collisions & 0x01)
+          context_->sprite[context_->num_sprites++] = chips_->oam->At(entry);
       }
-      BIT(ppustatus, sprite_overflow) = (context_->num_sprites > PPU::kNumSprites);
+      BIT(ppustatus, sprite_overflow) = collisions != 0;
     }
 
     void GatherSpAt(std::int16_t scanline) {
@@ -364,8 +408,8 @@ class RP2C02 final : public PPU {
           addr = ((context_->sprite[entry].id & 0x01) << 12)
             | ((IsTopHalf(scanline, entry) ? (context_->sprite[entry].id & 0xFE) : ((context_->sprite[entry].id & 0xFE) + 1)) << 4)
             | (IsFlippedV(entry) ? (7 - ((scanline - context_->sprite[entry].y) & 0x07)) : ((scanline - context_->sprite[entry].y) & 0x07));
-        Byte pttr_lo = mmu_->Read(addr + 0);
-        Byte pttr_hi = mmu_->Read(addr + 8);
+        Byte pttr_lo = Fetch(addr + 0);
+        Byte pttr_hi = Fetch(addr + 8);
         if (IsFlippedH(entry)) {
           // https://stackoverflow.com/a/2602885
           auto flip = [](Byte byte) {
@@ -378,8 +422,25 @@ class RP2C02 final : public PPU {
           pttr_hi = flip(pttr_hi);
         }
 
-        SPRT(pttr_lo, entry) = pttr_lo; 
-        SPRT(pttr_hi, entry) = pttr_hi;
+        RasterizeSp(entry, pttr_lo, pttr_hi);
+      }
+    }
+
+    /*
+     * Sprites are rasterized into the line buffer in OAM order, so that each pixel is taken from
+     * the first opaque sprite and composing a pixel takes a single lookup.
+     */
+    void RasterizeSp(std::size_t entry, Byte pttr_lo, Byte pttr_hi) {
+      const auto& sprite = context_->sprite[entry];
+      for (std::size_t col = 0; col < 8 && sprite.x + col < PPU::kFrameW; col++) {
+        auto& pixel = SPRT(sprite.x + col);
+        if (pixel.pixel) continue;
+        const Byte pix = (((pttr_hi << col) & 0x80) >> 6) | (((pttr_lo << col) & 0x80) >> 7);
+        if (pix == 0) continue;
+        pixel.value = pix
+          | ((sprite.attr & 0x03) << 2)
+          | (((sprite.attr & 0x20) >> 5) << 4)
+          | (static_cast<Byte>(entry == 0) << 5);
       }
     }
 
@@ -390,22 +451,45 @@ class RP2C02 final : public PPU {
         bg_pix = (static_cast<Byte>((BACK(pttr_hi) & FINE_X) > 0) << 1) | static_cast<Byte>((BACK(pttr_lo) & FINE_X) > 0);
         bg_pal = (static_cast<Byte>((BACK(attr_hi) & FINE_X) > 0) << 1) | static_cast<Byte>((BACK(attr_lo) & FINE_X) > 0);
       }
+      ComposeAt(cycle, scanline, bg_pix, bg_pal);
+    }
+
+    /*
+     * Composes the visible dots of a scanline at once, taking the background out of the layer
+     * cache at the current scroll. Valid only when nothing has disturbed the pipeline since the
+     * prefetches of the line, whose first two tiles have already been fetched and scrolled over.
+     */
+    void ComposeLine(std::int16_t scanline) {
+      RefreshBg();
+      const std::size_t row  = (BIT(vramaddr, nametable_y) * 30 + BIT(vramaddr, coarse_y)) * 8 + BIT(vramaddr, fine_y);
+      const std::size_t left = ((((BIT(vramaddr, nametable_x) << 5) | BIT(vramaddr, coarse_x)) - 2) & 0x3F) * 8 + REG(fine_x);
+      const Byte* const pixels = &layer_[row * kLayerW];
+      for (std::int16_t cycle = 1; cycle <= PPU::kFrameW; cycle++) {
+        Byte bg = 0x00;
+        if (BIT(ppumask, background_enable) && (BIT(ppumask, background_leftmost_enable) || cycle >= 9))
+          bg = pixels[(left + cycle - 1) % kLayerW];
+        ComposeAt(cycle, scanline, bg & 0x03, bg >> 2);
+      }
+    }
+
+    /*
+     * Coarse y beyond the 30th row fetches attributes as tiles, which is left to the pipeline.
+     */
+    bool IsLayered() const {
+      return BIT(vramaddr, coarse_y) < 30;
+    }
+
+    void ComposeAt(std::int16_t cycle, std::int16_t scanline, Byte bg_pix, Byte bg_pal) {
       Byte fg_pix = 0x00;
       Byte fg_pal = 0x00;
       [[maybe_unused]]Byte fg_pri = 0x00;
-      if (BIT(ppumask, sprite_enable) && (BIT(ppumask, sprite_leftmost_enable) || (cycle >= 9))) {
-        sprite_zero_rendered_ = false;
-        for (std::size_t entry = 0; entry < context_->num_sprites; entry++) {
-          if (context_->sprite[entry].x == 0) {
-            fg_pix = (static_cast<Byte>((SPRT(pttr_hi, entry) & 0x80) > 0) << 1) | static_cast<Byte>((SPRT(pttr_lo, entry) & 0x80) > 0);
-            fg_pal = (context_->sprite[entry].attr & 0x03) + 0x04;
-            fg_pri = (context_->sprite[entry].attr & 0x20) == 0;
-            if (fg_pix != 0) {
-              if (entry == 0) sprite_zero_rendered_ = true;
-              break;
-            }
-          }
-        }
+      if (BIT(ppumask, sprite_enable) && (BIT(ppumask, sprite_leftmost_enable) || (cycle >= 9))
+          && 0 <= scanline && scanline < PPU::kFrameH && 1 <= cycle && cycle <= PPU::kFrameW) {
+        const auto& pixel = SPRT(cycle - 1);
+        fg_pix = pixel.pixel;
+        fg_pal = pixel.palette + 0x04;
+        fg_pri = !pixel.priority;
+        sprite_zero_rendered_ = pixel.sprite_zero;
       }
       Byte pix = 0x00;
       Byte pal = 0x00;
@@ -423,11 +507,129 @@ class RP2C02 final : public PPU {
         pal = fg_pri ? fg_pal : bg_pal;
         if (SpriteZeroHitOccur()) SpriteZeroHitAt(cycle);
       }
+      if (!context_->IsWriting()) return;
       if (0 <= cycle - 1 && cycle -1 < PPU::kFrameW && 0 <= scanline && scanline < PPU::kFrameH)
-        context_->pixel_writer(
-          cycle - 1,
-          scanline,
-          colours_->Get(BIT(ppumask, intensity), mmu_->Read(0x3F00 + (pal << 2) + pix) & 0x3F));
+        context_->pixel_writer(cycle - 1, scanline, palette_[(pal << 2) + pix]);
+    }
+
+    /*
+     * While no pixel is written, the pixel pipeline is only needed on lines where sprite 0 may hit.
+     * Note that sprites are evaluated at the end of the preceding line, so this also holds for
+     * the prefetches of the next line.
+     */
+    bool IsComposing() const {
+      return context_->IsWriting() || may_sprite_zero_hit_;
+    }
+
+    ARGB Backdrop() const {
+      return palette_[0x00];
+    }
+
+    void ResolvePalette() {
+      for (Address entry = 0x00; entry < 0x20; entry++) Resolve(entry);
+    }
+
+    /*
+     * Pattern tables and nametables are fetched through the pages resolved here, falling back to
+     * the bus for those which are not kept in place. Returns true if the layer cache has been
+     * invalidated, i.e., if any page has moved or is not kept in place.
+     */
+    bool Remap() {
+      bool moved = false;
+      for (std::size_t page = 0; page < pages_.size(); page++) {
+        const auto* const resolved = mmu_->PageAt(page << 10);
+        moved |= !resolved || resolved != pages_[page];
+        pages_[page] = resolved;
+      }
+      if (moved) InvalidateBg();
+      return moved;
+    }
+
+    /*
+     * Tells whether writing the byte changes the memory, comparing against the pages kept in place
+     * rather than reading through the bus, as reads latch banks on some mappers. Writes to pages not
+     * kept in place are taken as changes, while the palette is the PPU's own to read.
+     */
+    bool Changes(Address address, Byte byte) const {
+      if (address >= 0x3F00) return mmu_->Read(address) != byte;
+      const Address mirrored = address < 0x3000 ? address : address - 0x1000;
+      return !pages_[mirrored >> 10] || pages_[mirrored >> 10][mirrored & 0x03FF] != byte;
+    }
+
+    void InvalidateBg() {
+      stale_tiles_.set();
+      stale_ = true;
+    }
+
+    /*
+     * Marks tiles affected by a write to the PPU bus. Which nametables mirror each other is left
+     * to the bus, so a nametable write marks the tile in all four of them.
+     */
+    void InvalidateBgAt(Address address) {
+      if (address < 0x2000) {
+        stale_patterns_.set(address >> 4);
+      } else {
+        const Address offset = address & 0x03FF;
+        for (std::size_t nametable = 0; nametable < 4; nametable++) {
+          const std::size_t x = (nametable & 0x01) * 32;
+          const std::size_t y = (nametable >> 1)   * 30;
+          if (offset < 0x03C0) {
+            stale_tiles_.set(TileAt(x + offset % 32, y + offset / 32));
+          } else {
+            // An attribute byte covers 4x4 tiles, while the last row of them is half cut off.
+            const std::size_t attr_x = (offset - 0x03C0) % 8 * 4;
+            const std::size_t attr_y = (offset - 0x03C0) / 8 * 4;
+            for (std::size_t tile_y = attr_y; tile_y < std::min<std::size_t>(attr_y + 4, 30); tile_y++)
+              for (std::size_t tile_x = attr_x; tile_x < attr_x + 4; tile_x++)
+                stale_tiles_.set(TileAt(x + tile_x, y + tile_y));
+          }
+        }
+      }
+      stale_ = true;
+    }
+
+    void RenderPatternTable(std::size_t table, Byte palette, ARGB* const pixels) const {
+      for (std::size_t tile = 0; tile < 0x100; tile++)
+        for (std::size_t row = 0; row < 8; row++)
+          Decode((table << 12) | (tile << 4), row, palette, false,
+                 &pixels[(tile / 16 * 8 + row) * PPU::kPatternTableW + tile % 16 * 8]);
+    }
+
+    void RenderNametables(ARGB* const pixels) const {
+      for (std::size_t tile_y = 0; tile_y < kLayerH / 8; tile_y++) {
+        for (std::size_t tile_x = 0; tile_x < kLayerW / 8; tile_x++) {
+          const Address pattern = (BIT(ppuctrl, background_tile) << 12) + (Fetch(NametableAt(tile_x, tile_y)) << 4);
+          const Byte palette = AttributeOf(tile_x, tile_y);
+          for (std::size_t row = 0; row < 8; row++)
+            Decode(pattern, row, palette, false, &pixels[(tile_y * 8 + row) * PPU::kNametablesW + tile_x * 8]);
+        }
+      }
+    }
+
+    void RenderSprites(ARGB* const pixels) const {
+      const std::size_t height = Is8x8Mode() ? 8 : 16;
+      for (std::size_t entry = 0; entry < 64; entry++) {
+        const auto& sprite = chips_->oam->At(entry);
+        ARGB* const cell = &pixels[entry / 8 * 16 * PPU::kSpritesW + entry % 8 * 8];
+        for (std::size_t row = height; row < 16; row++) std::fill_n(&cell[row * PPU::kSpritesW], 8, palette_[0x00]);
+        for (std::size_t row = 0; row < height; row++) {
+          const std::size_t line = (sprite.attr & 0x80) ? height - 1 - row : row;
+          const Address pattern = Is8x8Mode()
+            ? (BIT(ppuctrl, sprite_tile) << 12) | (sprite.id << 4)
+            : ((sprite.id & 0x01) << 12) | (((sprite.id & 0xFE) + (line >> 3)) << 4);
+          Decode(pattern, line & 0x07, (sprite.attr & 0x03) + 0x04, sprite.attr & 0x40, &cell[row * PPU::kSpritesW]);
+        }
+      }
+    }
+
+    void RenderPalette(ARGB* const colours) const {
+      std::copy(palette_.begin(), palette_.end(), colours);
+    }
+
+    void ResolvePaletteAt(Address address) {
+      Resolve(address & 0x1F);
+      // $3F10/$3F14/$3F18/$3F1C are mirrors of $3F00/$3F04/$3F08/$3F0C.
+      if ((address & 0x03) == 0) Resolve((address & 0x1F) ^ 0x10);
     }
 
    NESDEV_CORE_PRIVATE_UNLESS_TESTED:
@@ -456,6 +658,91 @@ class RP2C02 final : public PPU {
         && BIT(ppumask, sprite_enable);
     }
 
+    /*
+     * Palette RAM is resolved to output colours ahead of time, so that composing a pixel
+     * does not have to go through the PPU bus nor the colour lookup.
+     * [SEE] https://wiki.nesdev.com/w/index.php/PPU_palettes
+     */
+    void Resolve(Address entry) {
+      palette_[entry] = colours_->Get(
+        BIT(ppumask, intensity),
+        mmu_->Read(0x3F00 + entry) & (BIT(ppumask, greyscale) ? 0x30 : 0x3F));
+    }
+
+    static std::size_t TileAt(std::size_t tile_x, std::size_t tile_y) {
+      return tile_y * (kLayerW / 8) + tile_x;
+    }
+
+    static Address NametableAt(std::size_t tile_x, std::size_t tile_y) {
+      return 0x2000 | ((tile_y / 30) << 11) | ((tile_x / 32) << 10) | ((tile_y % 30) << 5) | (tile_x % 32);
+    }
+
+    static Address AttributeAt(std::size_t tile_x, std::size_t tile_y) {
+      return 0x23C0 | ((tile_y / 30) << 11) | ((tile_x / 32) << 10) | ((tile_y % 30 >> 2) << 3) | (tile_x % 32 >> 2);
+    }
+
+    /*
+     * Rebuilds the stale tiles of the layer cache. Palette indices are cached rather than colours,
+     * so that palette writes never get the cache stale. The cache is allocated once first composed
+     * from, so that machines never composing, e.g., forks with their output skipped, go without.
+     */
+    void RefreshBg() {
+      if (layer_.empty()) {
+        layer_.resize(kLayerW * kLayerH, 0x00);
+        stale_tiles_.set();
+        stale_ = true;
+      }
+      if (!stale_) return;
+      if (stale_patterns_.any()) {
+        for (std::size_t tile_y = 0; tile_y < kLayerH / 8; tile_y++)
+          for (std::size_t tile_x = 0; tile_x < kLayerW / 8; tile_x++)
+            if (stale_patterns_[(BIT(ppuctrl, background_tile) << 8) | Fetch(NametableAt(tile_x, tile_y))])
+              stale_tiles_.set(TileAt(tile_x, tile_y));
+        stale_patterns_.reset();
+      }
+      for (std::size_t tile = 0; tile < stale_tiles_.size(); tile++)
+        if (stale_tiles_[tile]) RebuildBgAt(tile % (kLayerW / 8), tile / (kLayerW / 8));
+      stale_tiles_.reset();
+      stale_ = false;
+    }
+
+    Byte AttributeOf(std::size_t tile_x, std::size_t tile_y) const {
+      Byte attr = Fetch(AttributeAt(tile_x, tile_y));
+      if (tile_y % 30 & 0x02) attr >>= 4;
+      if (tile_x % 32 & 0x02) attr >>= 2;
+      return attr & 0x03;
+    }
+
+    void RebuildBgAt(std::size_t tile_x, std::size_t tile_y) {
+      const Byte attr = AttributeOf(tile_x, tile_y) << 2;
+      const Address pattern = (BIT(ppuctrl, background_tile) << 12) + (Fetch(NametableAt(tile_x, tile_y)) << 4);
+      for (std::size_t row = 0; row < 8; row++) {
+        const Byte lsb = Fetch(pattern + row);
+        const Byte msb = Fetch(pattern + row + 8);
+        Byte* const pixels = &layer_[(tile_y * 8 + row) * kLayerW + tile_x * 8];
+        for (std::size_t col = 0; col < 8; col++)
+          pixels[col] = attr | (((msb << col) & 0x80) >> 6) | (((lsb << col) & 0x80) >> 7);
+      }
+    }
+
+    /*
+     * Decodes a row of a tile into colours, where transparent pixels take the backdrop colour.
+     */
+    void Decode(Address pattern, std::size_t row, Byte palette, bool flipped, ARGB* const pixels) const {
+      const Byte lsb = Fetch(pattern + row);
+      const Byte msb = Fetch(pattern + row + 8);
+      for (std::size_t col = 0; col < 8; col++) {
+        const std::size_t bit = flipped ? col : 7 - col;
+        const Byte pix = (((msb >> bit) & 0x01) << 1) | ((lsb >> bit) & 0x01);
+        pixels[col] = palette_[pix ? (palette << 2) | pix : 0x00];
+      }
+    }
+
+    Byte Fetch(Address address) const {
+      if (address < 0x3000 && pages_[address >> 10]) return pages_[address >> 10][address & 0x03FF];
+      else return mmu_->Read(address);
+    }
+
     void SpriteZeroHitAt(std::int16_t cycle) {
       if (!(BIT(ppumask, background_leftmost_enable) || BIT(ppumask, sprite_leftmost_enable))) {
         if (cycle >= 9 && cycle < 258) REG(ppustatus) |= MSK(sprite_zero_hit);
@@ -480,6 +767,26 @@ class RP2C02 final : public PPU {
     bool may_sprite_zero_hit_  = false;
 
     bool sprite_zero_rendered_ = false;
+
+    std::array<ARGB, 0x20> palette_ = {};
+
+    std::array<const Byte*, 0x0C> pages_ = {};
+
+    /*
+     * The background of all four nametables laid out as they are scrolled over, in palette indices.
+     * [SEE] https://wiki.nesdev.com/w/index.php/PPU_scrolling
+     */
+    static constexpr std::size_t kLayerW = 2 * PPU::kFrameW;
+
+    static constexpr std::size_t kLayerH = 2 * PPU::kFrameH;
+
+    std::vector<Byte> layer_;
+
+    std::bitset<(kLayerW / 8) * (kLayerH / 8)> stale_tiles_ = std::bitset<(kLayerW / 8) * (kLayerH / 8)>().set();
+
+    std::bitset<0x200> stale_patterns_;
+
+    bool stale_ = true;
   };
 
  NESDEV_CORE_PRIVATE_UNLESS_TESTED:
@@ -509,16 +816,55 @@ class RP2C02 final : public PPU {
 
  NESDEV_CORE_PRIVATE_UNLESS_TESTED:
   /* [SEE] https://wiki.nesdev.com/w/index.php/PPU_rendering */
-  void Ticked() {
-    NextCycle();
-    if (IsRendering() && (Cycle() == 260 && Scanline() < 240))
+  void Ticked(std::int16_t dots = 1) {
+    Cycle(Cycle() + dots);
+    // Shadows of the threaded rasterizer are never connected so as not to notify mappers twice.
+    if (rom_ && IsRendering() && (Cycle() == 260 && Scanline() < 240))
       rom_->mapper->OnVisibleCycleEnds();
     if (Cycle() >= 341) {
       Cycle(0); NextScanline();
       if (Scanline() >= 261) {
-        Scanline(-1); TransitFrame();
+        Scanline(-1); TransitFrame(); Memoize();
       }
     }
+    if (rasterizer_) {
+      rasterizer_->Ticked(dots);
+      if (IsPostRenderLine() && Cycle() == 0)
+        context_.frame_unchanged = rasterizer_->Commit(context_.skip_output, context_.pixel_writer);
+    } else if (IsPostRenderLine() && Cycle() == 0) {
+      context_.frame_unchanged = context_.unchanged;
+    }
+  }
+
+  /*
+   * Registers only matter as they are at the start of a frame, unless written while rendering it.
+   */
+  [[nodiscard]]
+  std::uint64_t Inputs() const {
+    const Byte ignored = registers_->ppuctrl.increment.mask
+      | registers_->ppuctrl.ppu_master_slave.mask
+      | registers_->ppuctrl.nmi_enable.mask;
+    return (static_cast<std::uint64_t>(REG(ppuctrl) & ~ignored) << 32)
+      | (static_cast<std::uint64_t>(REG(ppumask))          << 24)
+      | (static_cast<std::uint64_t>(REG(fine_x))           << 16)
+      | REG(tramaddr);
+  }
+
+  void Alter() {
+    altered_           = true;
+    context_.unchanged = false;
+  }
+
+  /*
+   * A frame is left unwritten if nothing it is rendered from has changed since the previous one
+   * started, provided that the pixel writer holds the previous one.
+   */
+  void Memoize() {
+    const auto inputs  = Inputs();
+    context_.unchanged = !altered_ && inputs == inputs_ && context_.presented && !context_.skip_output && !context_.offloaded;
+    context_.presented = !context_.skip_output && !context_.offloaded;
+    inputs_            = inputs;
+    altered_           = false;
   }
 
   [[nodiscard]]
@@ -556,14 +902,21 @@ class RP2C02 final : public PPU {
 
   void ReadPPUData() {
     latch_.ReadPPUData();
+    prefetched_ = false;
+    if (Scanline() < PPU::kFrameH) Alter();
   }
 
   void WritePPUCtrl(Byte byte) {
+    const Byte changed = REG(ppuctrl) ^ byte;
     latch_.WritePPUCtrl(byte);
+    if (changed & registers_->ppuctrl.background_tile.mask) shift_.InvalidateBg();
   }
 
   void WritePPUMask(Byte byte) {
+    const Byte changed = REG(ppumask) ^ byte;
     latch_.WritePPUMask(byte);
+    if (changed & (registers_->ppumask.intensity.mask | registers_->ppumask.greyscale.mask))
+      shift_.ResolvePalette();
   }
 
   void WritePPUStatus(Byte byte) {
@@ -575,6 +928,7 @@ class RP2C02 final : public PPU {
   }
 
   void WriteOAMData(Byte byte) {
+    if (chips_->oam->Read(REG(oamaddr)) != byte) Alter();
     latch_.WriteOAMData(byte);
   }
 
@@ -587,11 +941,34 @@ class RP2C02 final : public PPU {
   }
 
   void WritePPUData(Byte byte) {
+    const Address address = REG(vramaddr) & 0x3FFF;
+    if (shift_.Changes(address, byte)) Alter();
     latch_.WritePPUData(byte);
+    if (address >= 0x3F00) shift_.ResolvePaletteAt(address);
+    else                   shift_.InvalidateBgAt(address);
   }
 
-  void UpdateShiftAt(std::int16_t cycle) {
-    shift_.UpdateAt(cycle);
+  [[nodiscard]]
+  bool IsComposing() const {
+    return shift_.IsComposing();
+  }
+
+  /*
+   * The pipeline keeps fetching through unchanged frames, so that pixels can be written from any
+   * dot on once something changes.
+   */
+  [[nodiscard]]
+  bool IsFetching() const {
+    return IsRendering() && (shift_.IsComposing() || context_.unchanged);
+  }
+
+  [[nodiscard]]
+  ARGB Backdrop() const {
+    return shift_.Backdrop();
+  }
+
+  void UpdateShift() {
+    shift_.Update();
   }
 
   void LoadBg() {
@@ -630,12 +1007,19 @@ class RP2C02 final : public PPU {
     shift_.ComposeAt(cycle, scanline);
   }
 
+  [[nodiscard]]
+  bool IsLayered() const {
+    return prefetched_ && shift_.IsLayered();
+  }
+
+  void ComposeLine();
+
   void ScrollX() {
     if (IsRendering()) {
       // A single name table is 32 x 30 tiles.
       if (BIT(vramaddr, coarse_x) == 31) {
         BIT(vramaddr, coarse_x)    = 0;
-        BIT(vramaddr, nametable_x) = ~BIT(vramaddr, nametable_x);
+        BIT(vramaddr, nametable_x) = !BIT(vramaddr, nametable_x);
       } else {
         BIT(vramaddr, coarse_x)++;
       }
@@ -652,7 +1036,7 @@ class RP2C02 final : public PPU {
         BIT(vramaddr, fine_y) = 0;
         if (BIT(vramaddr, coarse_y) == 29) {
           BIT(vramaddr, coarse_y)    = 0;
-          BIT(vramaddr, nametable_y) = ~BIT(vramaddr, nametable_y);
+          BIT(vramaddr, nametable_y) = !BIT(vramaddr, nametable_y);
         } else if (BIT(vramaddr, coarse_y) == 31) {
           BIT(vramaddr, coarse_y) = 0;
         } else {
@@ -689,6 +1073,21 @@ class RP2C02 final : public PPU {
   Latch latch_;
 
   Shift shift_;
+
+  std::unique_ptr<Rasterizer> rasterizer_;
+
+  /*
+   * Whether the pipeline has been left undisturbed by the CPU since the prefetches of the line.
+   */
+  bool prefetched_ = false;
+
+  /*
+   * Whether anything frames are rendered from has changed since the current frame started, and
+   * the registers as they were then.
+   */
+  bool altered_ = true;
+
+  std::uint64_t inputs_ = {0};
 };
 
 #undef REG
@@ -698,8 +1097,6 @@ class RP2C02 final : public PPU {
 #undef SHIFT_BACK
 #undef PUSH_BACK
 #undef SPRT
-#undef SHIFT_SPRT
-#undef PUSH_SPRT
 #undef FINE_X
 
 }  // namespace detail
@@ -0,0 +1,31 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#ifndef _NESDEV_CORE_DETAIL_STATIC_NES_H_
+#define _NESDEV_CORE_DETAIL_STATIC_NES_H_
+#include "nesdev/core/nes.h"
+#include "detail/mmu.h"
+#include "detail/rp2a03.h"
+#include "detail/rp2c02.h"
+#include "detail/roms/mapper000.h"
+
+namespace nesdev {
+namespace core {
+namespace detail {
+
+/*
+ * Composes the NES out of the final implementations, so that the calls the run loop makes to the
+ * CPU, PPU, bus and mapper get resolved at compile time. Accepts NROM cartridges only.
+ */
+using StaticNES = BasicNES<RP2A03, RP2C02, MMU, roms::Mapper000>;
+
+}  // namespace detail
+
+extern template class BasicNES<detail::RP2A03, detail::RP2C02, detail::MMU, detail::roms::Mapper000>;
+
+}  // namespace core
+}  // namespace nesdev
+#endif  // ifndef _NESDEV_CORE_DETAIL_STATIC_NES_H_
@@ -7,6 +7,7 @@
 #include <cstddef>
 #include <functional>
 #include <memory>
+#include <utility>
 #include "nesdev/core/exceptions.h"
 #include "nesdev/core/macros.h"
 #include "nesdev/core/memory_bank.h"
@@ -84,6 +85,10 @@ class PPUAdapter : public MemoryBank {
     NESDEV_CORE_THROW(NotImplemented::Occur("Not implemented method operated to ::PPUAdapter"));
   }
 
+  const Byte* PageAt(Address address) const override {
+    return rom_->mapper->PageAt(ROM::Mapper::Space::PPU, address);
+  }
+
  NESDEV_CORE_PRIVATE_UNLESS_TESTED:
   ROM* const rom_;
 };
@@ -98,6 +103,16 @@ std::function<void(Address, Byte)> Writer(T* const device) {
   return [device](Address address, Byte byte) { device->Write(address, byte); };
 }
 
+template<typename T>
+std::function<Byte(Address)> Reader(T* const device, std::function<void()> synchronize) {
+  return [device, synchronize](Address address) { synchronize(); return device->Read(address); };
+}
+
+template<typename T>
+std::function<void(Address, Byte)> Writer(T* const device, std::function<void()> synchronize) {
+  return [device, synchronize](Address address, Byte byte) { synchronize(); device->Write(address, byte); };
+}
+
 }
 
 namespace nesdev {
@@ -107,17 +122,28 @@ MemoryBanks MemoryBankFactory::CPUBus(ROM* const rom,
                                       PPU* const ppu,
                                       NES::DirectMemoryAccess* const dma,
                                       NES::Controller* const controller_1,
-                                      NES::Controller* const controller_2) {
+                                      NES::Controller* const controller_2,
+                                      std::function<void()> synchronize) {
+  return CPUBus(rom, ::Reader(ppu, synchronize), ::Writer(ppu, synchronize), dma, controller_1, controller_2, synchronize);
+}
+
+MemoryBanks MemoryBankFactory::CPUBus(ROM* const rom,
+                                      std::function<Byte(Address)> ppu_reader,
+                                      std::function<void(Address, Byte)> ppu_writer,
+                                      NES::DirectMemoryAccess* const dma,
+                                      NES::Controller* const controller_1,
+                                      NES::Controller* const controller_2,
+                                      std::function<void()> synchronize) {
   MemoryBanks banks;
-  banks.push_back(std::make_unique<detail::memory_banks::Chip     <0x0000, 0x1FFF>>(0x800));                                          // RAM
-  banks.push_back(std::make_unique<detail::memory_banks::Connector<0x2000, 0x3FFF>>(::Reader(ppu), ::Writer(ppu)));                   // PPU
-  banks.push_back(std::make_unique<detail::memory_banks::Chip     <0x4000, 0x4013>>(0x14));                                           // IO
-  banks.push_back(std::make_unique<detail::memory_banks::Connector<0x4014, 0x4014>>(::Reader(dma), ::Writer(dma)));                   // DMA
-  banks.push_back(std::make_unique<detail::memory_banks::Chip     <0x4015, 0x4015>>(0x01));                                           // IO
-  banks.push_back(std::make_unique<detail::memory_banks::Connector<0x4016, 0x4016>>(::Reader(controller_1), ::Writer(controller_1))); // CTRL
-  banks.push_back(std::make_unique<detail::memory_banks::Connector<0x4017, 0x4017>>(::Reader(controller_2), ::Writer(controller_2))); // CTRL
-  banks.push_back(std::make_unique<detail::memory_banks::Chip     <0x4018, 0x401F>>(0x8));                                            // IO
-  banks.push_back(std::make_unique<::CPUAdapter>(rom));                                                                               // ROM
+  banks.push_back(std::make_unique<detail::memory_banks::Chip     <0x0000, 0x1FFF>>(0x800));                                                  // RAM
+  banks.push_back(std::make_unique<detail::memory_banks::Connector<0x2000, 0x3FFF>>(std::move(ppu_reader), std::move(ppu_writer)));          // PPU
+  banks.push_back(std::make_unique<detail::memory_banks::Chip     <0x4000, 0x4013>>(0x14));                                                   // IO
+  banks.push_back(std::make_unique<detail::memory_banks::Connector<0x4014, 0x4014>>(::Reader(dma, synchronize), ::Writer(dma, synchronize))); // DMA
+  banks.push_back(std::make_unique<detail::memory_banks::Chip     <0x4015, 0x4015>>(0x01));                                                   // IO
+  banks.push_back(std::make_unique<detail::memory_banks::Connector<0x4016, 0x4016>>(::Reader(controller_1), ::Writer(controller_1)));         // CTRL
+  banks.push_back(std::make_unique<detail::memory_banks::Connector<0x4017, 0x4017>>(::Reader(controller_2), ::Writer(controller_2)));         // CTRL
+  banks.push_back(std::make_unique<detail::memory_banks::Chip     <0x4018, 0x401F>>(0x8));                                                    // IO
+  banks.push_back(std::make_unique<::CPUAdapter>(rom));                                                                                       // ROM
   return banks;
 }
 
@@ -0,0 +1,80 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <utility>
+#include "nesdev/core/exceptions.h"
+#include "nesdev/core/movie.h"
+#include "nesdev/core/snapshot.h"
+#include "nesdev/core/types.h"
+
+namespace {
+
+using namespace nesdev::core;
+
+constexpr char kMagic[4] = {'N', 'E', 'S', 'M'};
+
+template <typename T>
+void Put(T value, Byte* const out) {
+  for (std::size_t i = 0; i < sizeof(T); i++) out[i] = static_cast<Byte>(value >> (i * 8));
+}
+
+template <typename T>
+T Get(const Byte* const in) {
+  T value = 0;
+  for (std::size_t i = 0; i < sizeof(T); i++) value |= static_cast<T>(in[i]) << (i * 8);
+  return value;
+}
+
+}
+
+namespace nesdev {
+namespace core {
+
+void Movie::Save(std::ostream& os) const {
+  std::vector<Byte> data(kHeaderSize);
+  const std::size_t state_size = Snapshot::Compress(start_.data(), start_.size(), &data);
+  const std::size_t input_size = Snapshot::Compress(inputs_.data(), inputs_.size(), &data);
+  std::copy(std::begin(kMagic), std::end(kMagic), &data[0]);
+  ::Put<std::uint32_t>(kVersion, &data[4]);
+  ::Put<std::uint64_t>(rom_hash_, &data[8]);
+  ::Put<std::uint32_t>(static_cast<std::uint32_t>(Frames()), &data[16]);
+  ::Put<std::uint32_t>(from_power_on_ ? kFromPowerOn : 0x00000000, &data[20]);
+  ::Put<std::uint32_t>(static_cast<std::uint32_t>(start_.size()), &data[24]);
+  ::Put<std::uint32_t>(static_cast<std::uint32_t>(state_size), &data[28]);
+  ::Put<std::uint32_t>(static_cast<std::uint32_t>(input_size), &data[32]);
+  os.write(reinterpret_cast<const char*>(data.data()), data.size());
+  if (!os) NESDEV_CORE_THROW(InvalidOperation::Occur("Failed to write nesdev::core::Movie"));
+}
+
+void Movie::Load(std::istream& is) {
+  Byte header[kHeaderSize];
+  is.read(reinterpret_cast<char*>(header), sizeof(header));
+  if (static_cast<std::size_t>(is.gcount()) != sizeof(header))
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Truncated movie specified to nesdev::core::Movie::Load"));
+  if (!std::equal(std::begin(kMagic), std::end(kMagic), header))
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Incompatible file format specified to nesdev::core::Movie::Load"));
+  if (::Get<std::uint32_t>(&header[4]) != kVersion)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Incompatible version specified to nesdev::core::Movie::Load"));
+  const auto flags = ::Get<std::uint32_t>(&header[20]);
+  if ((flags & ~kFromPowerOn) != 0 || ((flags & kFromPowerOn) != 0) != (::Get<std::uint32_t>(&header[24]) == 0))
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted movie specified to nesdev::core::Movie::Load"));
+  // Read aside, so that the movie is left as is should the file be corrupted.
+  std::vector<Byte> start(::Get<std::uint32_t>(&header[24]));
+  std::vector<Byte> inputs(2 * ::Get<std::uint32_t>(&header[16]));
+  Snapshot::Decompress(is, ::Get<std::uint32_t>(&header[28]), start.data(), start.size());
+  Snapshot::Decompress(is, ::Get<std::uint32_t>(&header[32]), inputs.data(), inputs.size());
+  rom_hash_      = ::Get<std::uint64_t>(&header[8]);
+  from_power_on_ = (flags & kFromPowerOn) != 0;
+  start_         = std::move(start);
+  inputs_   = std::move(inputs);
+  position_ = 0;
+}
+
+}  // namespace core
+}  // namespace nesdev
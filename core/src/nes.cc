@@ -4,8 +4,14 @@
  * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
  * Trademarks are owned by their respect owners.
  */
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <memory.h>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
 #include "nesdev/core/clock.h"
 #include "nesdev/core/cpu.h"
 #include "nesdev/core/cpu_factory.h"
@@ -15,52 +21,772 @@
 #include "nesdev/core/mmu.h"
 #include "nesdev/core/mmu_factory.h"
 #include "nesdev/core/nes.h"
+#include "nesdev/core/opcodes.h"
 #include "nesdev/core/ppu.h"
 #include "nesdev/core/ppu_factory.h"
 #include "nesdev/core/rom.h"
 #include "nesdev/core/rom_factory.h"
 #include "nesdev/core/types.h"
+#include "detail/ppu_worker.h"
+#include "detail/static_nes.h"
+
+namespace {
+
+using namespace nesdev::core;
+
+// The dots the CPU runs ahead of the worker before handing them over, while speculating.
+constexpr std::size_t kSpeculationBatch = 3 * 32;
+
+template <typename T, typename U>
+std::unique_ptr<T> Downcast(std::unique_ptr<U> ptr) {
+  return std::unique_ptr<T>(static_cast<T*>(ptr.release()));
+}
+
+/*
+ * Copies the contents of the specified memory out, returning the end of the copy.
+ */
+Byte* Copy(const MemoryBank& memory, Byte* const data) {
+  if (memory.Size() > 0) std::copy_n(memory.Data(), memory.Size(), data);
+  return data + memory.Size();
+}
+
+const Byte* Restore(MemoryBank* const memory, const Byte* const data) {
+  if (memory->Size() > 0) std::copy_n(data, memory->Size(), memory->Data());
+  return data + memory->Size();
+}
+
+/*
+ * Visits the fields of the specified state in the order encoded, so that encoding, decoding and
+ * sizing never disagree.
+ */
+template <typename State, typename Archive>
+void Visit(State& state, Archive& archive) {
+  archive(state.cycle);
+  archive(state.ppu_accessed);
+  archive(state.nmi);
+  auto& cpu = state.cpu;
+  archive(cpu.registers.a.value);
+  archive(cpu.registers.x.value);
+  archive(cpu.registers.y.value);
+  archive(cpu.registers.s.value);
+  archive(cpu.registers.pc.value);
+  archive(cpu.registers.p.value);
+  archive.Size(cpu.context.cycle);
+  archive(cpu.context.fetched);
+  archive(cpu.context.opcode_byte);
+  archive.Engaged(cpu.context.opcode, cpu.context.opcode_byte);
+  archive(cpu.context.is_page_crossed);
+  archive(cpu.context.address.effective);
+  archive(cpu.context.pointer.effective);
+  archive(cpu.status);
+  archive(cpu.num_steps);
+  for (auto& step : cpu.steps) archive(step);
+  auto& ppu = state.ppu;
+  archive(ppu.registers.ppuctrl.value);
+  archive(ppu.registers.ppumask.value);
+  archive(ppu.registers.ppustatus.value);
+  archive(ppu.registers.oamaddr.value);
+  archive(ppu.registers.oamdata.value);
+  archive(ppu.registers.fine_x.value);
+  archive(ppu.registers.vramaddr.value);
+  archive(ppu.registers.tramaddr.value);
+  archive(ppu.registers.ppudata.value);
+  archive(ppu.registers.oamdma.value);
+  archive(ppu.shifters.background_pttr_lo.value);
+  archive(ppu.shifters.background_pttr_hi.value);
+  archive(ppu.shifters.background_attr_lo.value);
+  archive(ppu.shifters.background_attr_hi.value);
+  for (auto& pixel : ppu.shifters.sprite_line) archive(pixel.value);
+  archive(ppu.cycle);
+  archive(ppu.scanline);
+  archive(ppu.odd_frame);
+  archive(ppu.background.id);
+  archive(ppu.background.attr);
+  archive(ppu.background.lsb);
+  archive(ppu.background.msb);
+  for (auto& sprite : ppu.sprite) {
+    archive(sprite.y);
+    archive(sprite.id);
+    archive(sprite.attr);
+    archive(sprite.x);
+  }
+  archive.Size(ppu.num_sprites);
+  archive(ppu.latch);
+  archive(ppu.deffered);
+  archive(ppu.is_latched);
+  archive(ppu.may_sprite_zero_hit);
+  archive(ppu.sprite_zero_rendered);
+  archive(ppu.prefetched);
+  archive(ppu.altered);
+  archive(ppu.inputs);
+  archive(state.dma.address);
+  archive(state.dma.data);
+  archive(state.dma.transfer);
+  archive(state.dma.wait_for_even_cycle);
+  for (auto* const controller : {&state.controller_1, &state.controller_2}) {
+    archive(controller->state);
+    archive(controller->piso);
+  }
+  for (auto& byte : state.ram)     archive(byte);
+  for (auto& byte : state.io)      archive(byte);
+  for (auto& byte : state.palette) archive(byte);
+  for (auto& byte : state.oam)     archive(byte);
+}
+
+class Sizer {
+ public:
+  template <typename T>
+  void operator()(const T&) {
+    size += std::is_same_v<T, bool> ? 1 : sizeof(T);
+  }
+
+  void Size(std::size_t) {
+    size += sizeof(std::uint64_t);
+  }
+
+  void Engaged(const std::optional<Opcode>&, Byte) {
+    size += 1;
+  }
+
+  std::size_t size = {0};
+};
+
+class Encoder {
+ public:
+  explicit Encoder(Byte* const out) : out_{out} {}
+
+  void operator()(bool value) {
+    *out_++ = value ? 0x01 : 0x00;
+  }
+
+  template <typename T>
+  void operator()(T value) {
+    static_assert(std::is_integral_v<T>, "Fields must be integers");
+    const auto bits = static_cast<std::make_unsigned_t<T>>(value);
+    for (std::size_t i = 0; i < sizeof(T); i++) *out_++ = static_cast<Byte>(bits >> (i * 8));
+  }
+
+  void Size(std::size_t value) {
+    (*this)(static_cast<std::uint64_t>(value));
+  }
+
+  void Engaged(const std::optional<Opcode>& opcode, Byte) {
+    (*this)(opcode.has_value());
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  Byte* out_;
+};
+
+class Decoder {
+ public:
+  explicit Decoder(const Byte* const in) : in_{in} {}
+
+  void operator()(bool& value) {
+    const Byte byte = *in_++;
+    if (byte > 0x01) NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted state specified to nesdev::core::NESBase::Decode"));
+    value = byte == 0x01;
+  }
+
+  template <typename T>
+  void operator()(T& value) {
+    static_assert(std::is_integral_v<T>, "Fields must be integers");
+    using Bits = std::make_unsigned_t<T>;
+    Bits bits = 0;
+    for (std::size_t i = 0; i < sizeof(T); i++) bits |= static_cast<Bits>(static_cast<Bits>(*in_++) << (i * 8));
+    value = static_cast<T>(bits);
+  }
+
+  void Size(std::size_t& value) {
+    std::uint64_t wide;
+    (*this)(wide);
+    if (wide > std::numeric_limits<std::size_t>::max())
+      NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted state specified to nesdev::core::NESBase::Decode"));
+    value = static_cast<std::size_t>(wide);
+  }
+
+  /*
+   * The opcode in flight is always the one the opcode byte decodes to.
+   */
+  void Engaged(std::optional<Opcode>& opcode, Byte byte) {
+    bool engaged;
+    (*this)(engaged);
+    opcode.reset();
+    if (!engaged) return;
+    try {
+      opcode = Opcodes::Decode(byte);
+    } catch (const std::out_of_range&) {
+      NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted state specified to nesdev::core::NESBase::Decode"));
+    }
+  }
+
+ NESDEV_CORE_PRIVATE_UNLESS_TESTED:
+  const Byte* in_;
+};
+
+template <typename MapperT>
+MapperT* MapperOf(ROM* const rom) {
+  auto mapper = dynamic_cast<MapperT*>(rom->mapper.get());
+  if (!mapper) NESDEV_CORE_THROW(InvalidROM::Occur("The mapper does not match the composition of nesdev::core::BasicNES"));
+  return mapper;
+}
+
+}
 
 namespace nesdev {
 namespace core {
 
-NES::NES(std::unique_ptr<ROM> rom)
-    : rom{std::move(rom)},
-      dma{std::make_unique<NES::DirectMemoryAccess>()},
-      controller_1{std::make_unique<NES::Controller>()},
-      controller_2{std::make_unique<NES::Controller>()},
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+BasicNES<CpuT, PpuT, BusT, MapperT>::BasicNES(std::unique_ptr<ROM> rom, PPU::Rasterization rasterization)
+    : rasterization_{rasterization},
+      rom{std::move(rom)},
+      mapper{::MapperOf<MapperT>(this->rom.get())},
+      dma{std::make_unique<DirectMemoryAccess>()},
+      controller_1{std::make_unique<Controller>()},
+      controller_2{std::make_unique<Controller>()},
       ppu_registers{std::make_unique<PPU::Registers>()},
       ppu_shifters{std::make_unique<PPU::Shifters>()},
       ppu_chips{std::make_unique<PPU::Chips>(std::make_unique<PPU::ObjectAttributeMap<64>>())},
-      ppu_bus{MMUFactory::Create(MemoryBankFactory::PPUBus(this->rom.get()))},
-      ppu{PPUFactory::RP2C02(ppu_chips.get(), ppu_registers.get(), ppu_shifters.get(), ppu_bus.get())},
+      ppu_bus{::Downcast<BusT>(MMUFactory::Create(MemoryBankFactory::PPUBus(this->rom.get())))},
+      ppu{::Downcast<PpuT>(rasterization == PPU::Rasterization::THREADED
+          ? PPUFactory::ThreadedRP2C02(ppu_chips.get(), ppu_registers.get(), ppu_shifters.get(), ppu_bus.get(), this->rom.get())
+          : PPUFactory::RP2C02(ppu_chips.get(), ppu_registers.get(), ppu_shifters.get(), ppu_bus.get()))},
       cpu_registers{std::make_unique<CPU::Registers>()},
-      cpu_bus{MMUFactory::Create(MemoryBankFactory::CPUBus(this->rom.get(), ppu.get(), dma.get(), controller_1.get(), controller_2.get()))},
-      cpu{CPUFactory::RP2A03(cpu_registers.get(), cpu_bus.get())} {
+      cpu_bus{::Downcast<BusT>(MMUFactory::Create(MemoryBankFactory::CPUBus(this->rom.get(),
+                                                                             [this](Address address) { return ReadPPU(address); },
+                                                                             [this](Address address, Byte byte) { WritePPU(address, byte); },
+                                                                             dma.get(), controller_1.get(), controller_2.get(),
+                                                                             [this]() { Access(); })))},
+      cpu{::Downcast<CpuT>(CPUFactory::RP2A03(cpu_registers.get(), cpu_bus.get()))} {
   // https://wiki.nesdev.com/w/index.php/CPU_power_up_state
   ppu->Connect(this->rom.get());
   cpu->Reset();
   cpu_registers->p.value = {0x34};
+  Save(&power_on_);
 }
 
-void NES::Tick() {
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+BasicNES<CpuT, PpuT, BusT, MapperT>::~BasicNES() {
+  // Stopped before the PPU it runs goes.
+  worker_.reset();
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Tick() {
   ppu->Tick();
   if (cycle % 3 == 0) {
     if (dma->IsTransfering()) {
-      dma->TransactAt(cycle, cpu_bus.get(), ppu_chips.get());
+      dma->TransactAt(cycle, cpu_bus.get(), ppu.get());
     }
     else cpu->Tick();
   }
-  if (ppu_registers->ppuctrl.nmi_enable) {
-    ppu_registers->ppuctrl.nmi_enable = false;
-    cpu->NMI();
+  Poll();
+  cycle++;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Run(std::size_t dots) {
+  if (worker_) Drive<false, false, true>(dots, nullptr);
+  else Drive<false, false>(dots, nullptr);
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+NESBase::Status BasicNES<CpuT, PpuT, BusT, MapperT>::RunFrame(std::size_t dots) {
+  return worker_ ? Drive<true, false, true>(dots, nullptr) : Drive<true, false>(dots, nullptr);
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+NESBase::Status BasicNES<CpuT, PpuT, BusT, MapperT>::RunCycles(std::size_t dots) {
+  return worker_ ? Drive<false, false, true>(dots, nullptr) : Drive<false, false>(dots, nullptr);
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+NESBase::Status BasicNES<CpuT, PpuT, BusT, MapperT>::RunUntil(const Breakpoint& breakpoint, std::size_t dots) {
+  return Drive<false, true>(dots, &breakpoint);
+}
+
+/*
+ * Runs the specified number of dots, letting the CPU run ahead of the PPU. The CPU and PPU run in
+ * bulk until the next scheduled event, i.e., a mapper notification, the vblank or the end of a
+ * frame, and the PPU catches up only at those events, when the CPU accesses $2000-$3FFF or $4014
+ * and while DMA transfers, so that it gets ticked in tight batches.
+ *
+ * While speculating, the PPU is run by the worker in batches posted as the CPU goes, which waits
+ * for it on reads and events only, rolling back to the latest checkpoint should it turn out that a
+ * write has raised NMI.
+ */
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+template <bool kFrame, bool kBreakpoint, bool kSpeculative>
+NESBase::Status BasicNES<CpuT, PpuT, BusT, MapperT>::Drive(std::size_t dots, const Breakpoint* const breakpoint) {
+  using Event = Scheduler::Event;
+  CatchUp();
+  // The PPU may have been ticked on its own since, so that events get scheduled from scratch.
+  Schedule(Event::MAPPER);
+  Schedule(Event::VBLANK);
+  Schedule(Event::FRAME);
+  if constexpr (kSpeculative) {
+    speculating_ = true;
+    ppuctrl_     = ppu_registers->ppuctrl.value;
+  }
+  const std::uint64_t until = dots < std::numeric_limits<std::uint64_t>::max() - cycle ? cycle + dots : std::numeric_limits<std::uint64_t>::max();
+  while (true) {
+    const std::uint64_t next = std::min(scheduler_.Next(), until);
+    while (cycle < next) {
+      // The CPU is ticked every three dots, in between which the PPU is left pending.
+      const std::uint64_t idle = std::min<std::uint64_t>((3 - cycle % 3) % 3, next - cycle);
+      ppu_pending_ += idle;
+      cycle        += idle;
+      if (cycle == next) break;
+      ppu_pending_++;
+      bool ticked = false;
+      if (dma->IsTransfering()) {
+        if constexpr (kSpeculative) {
+          OAMWriter writer = {this};
+          dma->TransactAt(cycle, cpu_bus.get(), &writer);
+        } else {
+          CatchUp();
+          dma->TransactAt(cycle, cpu_bus.get(), ppu.get());
+        }
+      } else {
+        cpu->Tick();
+        ticked = true;
+      }
+      cycle++;
+      if constexpr (kSpeculative) {
+        if (checkpoint_wanted_) Checkpoint();
+        if (conflicted_) {
+          Rollback();
+          continue;
+        }
+        if (ppu_pending_ >= kSpeculationBatch) {
+          worker_->Run(ppu_pending_);
+          ppu_pending_ = 0;
+        }
+      }
+      if (ppu_accessed_) Poll();
+      if constexpr (kBreakpoint) {
+        if (ticked && cpu->IsIdle()) {
+          CatchUp();
+          if ((*breakpoint)(*this)) {
+            if (cycle == next) Dispatch();
+            return Status::BREAKPOINT;
+          }
+        }
+      }
+    }
+    if constexpr (kSpeculative) {
+      if (!Synchronize()) {
+        Rollback();
+        continue;
+      }
+    }
+    // Events due at the end of the budget get dispatched all the same, so as not to be missed.
+    const bool frame = Dispatch();
+    if constexpr (kFrame) {
+      if (frame) {
+        speculating_ = false;
+        return Status::FRAME;
+      }
+    }
+    if (cycle >= until) break;
+  }
+  speculating_ = false;
+  CatchUp();
+  return Status::BUDGET;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::CatchUp() {
+  if (ppu_pending_ > 0) {
+    ppu->Run(ppu_pending_);
+    ppu_pending_ = 0;
+  }
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+bool BasicNES<CpuT, PpuT, BusT, MapperT>::Access() {
+  if (speculating_ && !Synchronize()) return false;
+  CatchUp();
+  ppu_accessed_ = true;
+  return true;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+Byte BasicNES<CpuT, PpuT, BusT, MapperT>::ReadPPU(Address address) {
+  return Access() ? ppu->Read(address) : 0x00;
+}
+
+/*
+ * Writes get posted to the worker while speculating, with the CPU running on as if they have not
+ * raised NMI. Only the ones enabling NMI may, which get checkpointed one at a time, whereas the
+ * other ones have the interrupt lines left as they are.
+ */
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::WritePPU(Address address, Byte byte) {
+  if (!speculating_) {
+    if (Access()) ppu->Write(address, byte);
+    return;
+  }
+  const bool ppuctrl = (address & 0x0007) == 0x0000;
+  const bool verify  = ppuctrl && (byte & 0x80) && !(ppuctrl_ & 0x80);
+  if (ppuctrl) ppuctrl_ = byte;
+  if (verify && checkpointed_ && !Synchronize()) return;
+  worker_->Write(ppu_pending_, address, byte, verify);
+  ppu_pending_ = 0;
+  checkpoint_wanted_ = verify;
+  speculation_.writes++;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+bool BasicNES<CpuT, PpuT, BusT, MapperT>::Synchronize() {
+  if (ppu_pending_ > 0) {
+    worker_->Run(ppu_pending_);
+    ppu_pending_ = 0;
+  }
+  speculation_.synchronizations++;
+  if (!worker_->IsIdle()) speculation_.conflicts++;
+  if (!worker_->Wait()) {
+    conflicted_ = true;
+    return false;
+  }
+  checkpointed_ = false;
+  return true;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Checkpoint() {
+  checkpoint_wanted_   = false;
+  checkpointed_        = true;
+  checkpoint_.cycle    = cycle;
+  checkpoint_.nmi      = nmi_;
+  checkpoint_ppuctrl_  = ppuctrl_;
+  cpu->Save(&checkpoint_.cpu);
+  dma->Save(&checkpoint_.dma);
+  controller_1->Save(&checkpoint_.controller_1);
+  controller_2->Save(&checkpoint_.controller_2);
+  ::Copy(*cpu_bus->BankAt(0x0000), checkpoint_.ram);
+  for (Address address : {0x4000, 0x4015, 0x4018}) ::Copy(*cpu_bus->BankAt(address), &checkpoint_.io[address - 0x4000]);
+  checkpoint_prg_ram_.resize(rom->chips->prg_ram->Size());
+  ::Copy(*rom->chips->prg_ram, checkpoint_prg_ram_.data());
+}
+
+/*
+ * Brings the CPU back to right after the write which has raised NMI, where the worker has halted,
+ * and polls the interrupt lines as it would have done.
+ */
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Rollback() {
+  worker_->Wait();
+  worker_->Resume();
+  ::Restore(rom->chips->prg_ram.get(), checkpoint_prg_ram_.data());
+  ::Restore(cpu_bus->BankAt(0x0000), checkpoint_.ram);
+  for (Address address : {0x4000, 0x4015, 0x4018}) ::Restore(cpu_bus->BankAt(address), &checkpoint_.io[address - 0x4000]);
+  cpu->Load(checkpoint_.cpu);
+  dma->Load(checkpoint_.dma);
+  controller_1->Load(checkpoint_.controller_1);
+  controller_2->Load(checkpoint_.controller_2);
+  cycle              = checkpoint_.cycle;
+  ppuctrl_           = checkpoint_ppuctrl_;
+  ppu_pending_       = 0;
+  checkpoint_wanted_ = false;
+  checkpointed_      = false;
+  conflicted_        = false;
+  // The NMI line has been low right before the write, since it has been raised by it.
+  nmi_ = false;
+  Poll();
+  speculation_.rollbacks++;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::OAMWriter::WriteOAM(Byte address, Byte byte) {
+  nes->worker_->WriteOAM(nes->ppu_pending_, address, byte);
+  nes->ppu_pending_ = 0;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Own() {
+  const auto& chips = *rom->chips;
+  for (auto* const chip : {chips.prg_rom.get(), chips.prg_ram.get(), chips.chr_rom.get(), chips.chr_ram.get()}) {
+    if (chip->Size() > 0) static_cast<void>(chip->Data());
   }
-  if (rom->mapper->IRQ()) {
-    rom->mapper->ClearIRQ();
+  rom->mapper->Refresh();
+}
+
+/*
+ * Samples the interrupt lines. NMI is edge triggered, i.e., fires when the vblank flag and the NMI
+ * enable flag get both set, while mappers hold their IRQ until cleared.
+ */
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Poll() {
+  ppu_accessed_ = false;
+  const bool nmi = ppu_registers->ppustatus.vblank_start && ppu_registers->ppuctrl.nmi_enable;
+  if (nmi && !nmi_) cpu->NMI();
+  nmi_ = nmi;
+  if (mapper->IRQ()) {
+    mapper->ClearIRQ();
     cpu->IRQ();
   }
-  cycle++;
 }
 
+/*
+ * Dispatches the events due, returning true if a frame has completed.
+ */
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+bool BasicNES<CpuT, PpuT, BusT, MapperT>::Dispatch() {
+  using Event = Scheduler::Event;
+  bool frame = false;
+  if (scheduler_.At(Event::MAPPER) <= cycle) Dispatch(Event::MAPPER);
+  if (scheduler_.At(Event::VBLANK) <= cycle) Dispatch(Event::VBLANK);
+  if (scheduler_.At(Event::FRAME)  <= cycle) frame = Dispatch(Event::FRAME);
+  return frame;
+}
+
+/*
+ * Dispatches the specified event, which is put off by a dot if the PPU has not yet arrived, i.e.,
+ * if the dot scheduled as skipped on an odd frame has not been, rendering having been disabled.
+ * Returns true if the PPU has arrived.
+ */
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+bool BasicNES<CpuT, PpuT, BusT, MapperT>::Dispatch(Scheduler::Event event) {
+  using Event = Scheduler::Event;
+  CatchUp();
+  bool arrived = false;
+  switch (event) {
+  case Event::MAPPER: arrived = ppu->IsPreRenderOrVisibleLine() && ppu->Cycle() == 260; break;
+  case Event::VBLANK: arrived = ppu->Scanline() == 241 && ppu->Cycle() == 2;            break;
+  case Event::FRAME:  arrived = ppu->IsPostRenderLine() && ppu->Cycle() == 0;           break;
+  default: break;
+  }
+  if (arrived) Poll();
+  Schedule(event);
+  return arrived;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Schedule(Scheduler::Event event) {
+  using Event = Scheduler::Event;
+  std::size_t dots = 0;
+  switch (event) {
+  case Event::MAPPER: {
+    // Mappers get notified at the 260th cycle of the pre-render and visible lines, which is of
+    // interest only to the ones counting them.
+    if (!mapper->CountsScanlines()) {
+      scheduler_.Schedule(event, std::numeric_limits<std::uint64_t>::max());
+      return;
+    }
+    auto scanline = ppu->Cycle() < 260 ? ppu->Scanline() : ppu->Scanline() + 1;
+    if (scanline >= PPU::kFrameH) scanline = -1;
+    dots = ppu->DotsUntil(scanline, 260);
+    break;
+  }
+  // The vblank flag gets set at the 1st cycle of the 241st line.
+  case Event::VBLANK: dots = ppu->DotsUntil(241, 2); break;
+  case Event::FRAME:  dots = ppu->DotsUntil(240, 0); break;
+  default: break;
+  }
+  scheduler_.Schedule(event, cycle + dots);
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::SkipOutput(bool skip) {
+  ppu->SkipOutput(skip);
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Speculate(bool speculate) {
+  if (speculate == IsSpeculating()) return;
+  if (!speculate) {
+    worker_.reset();
+    return;
+  }
+  if (rasterization_ == PPU::Rasterization::THREADED)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Speculation with threaded rasterization specified to nesdev::core::BasicNES"));
+  CatchUp();
+  Own();
+  worker_ = std::make_unique<detail::PPUWorker>(ppu.get(), ppu_registers.get());
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+NESBase::Status BasicNES<CpuT, PpuT, BusT, MapperT>::RunFrameAhead(std::size_t frames) {
+  if (frames == 0) return RunFrame();
+  if (rasterization_ == PPU::Rasterization::THREADED)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Run-ahead with threaded rasterization specified to nesdev::core::BasicNES"));
+  const bool skip = ppu->IsSkippingOutput();
+  ppu->SkipOutput(true);
+  const auto status = RunFrame();
+  run_ahead_.resize(StateSize());
+  SaveState(run_ahead_.data(), run_ahead_.size());
+  for (std::size_t frame = 1; frame < frames; frame++) RunFrame();
+  ppu->SkipOutput(skip);
+  RunFrame();
+  LoadState(run_ahead_.data(), run_ahead_.size());
+  return status;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+std::size_t BasicNES<CpuT, PpuT, BusT, MapperT>::StateSize() const {
+  std::size_t size = EncodedStateSize();
+  for (const auto* const memory : Memories()) size += memory->Size();
+  return size;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::SaveState(Byte* const data, std::size_t size) {
+  if (size < StateSize()) NESDEV_CORE_THROW(InvalidOperation::Occur("Insufficient buffer specified to nesdev::core::BasicNES::SaveState"));
+  Byte* offset = data;
+  SaveState([&offset](const Byte* const section, std::size_t length) {
+    if (length > 0) offset = std::copy_n(section, length, offset);
+  });
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::SaveState(const StateWriter& writer) {
+  CatchUp();
+  State state = State();
+  Save(&state);
+  encoded_state_.resize(EncodedStateSize());
+  Encode(state, encoded_state_.data());
+  writer(encoded_state_.data(), encoded_state_.size());
+  for (const auto* const memory : Memories()) writer(memory->Size() > 0 ? memory->Data() : nullptr, memory->Size());
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::LoadState(const Byte* const data, std::size_t size) {
+  if (size != StateSize()) NESDEV_CORE_THROW(InvalidOperation::Occur("Snapshot does not match the cartridge specified to nesdev::core::BasicNES::LoadState"));
+  const Byte* offset = data;
+  LoadState([&offset](Byte* const section, std::size_t length) {
+    if (length > 0) std::copy_n(offset, length, section);
+    offset += length;
+  });
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::LoadState(const StateReader& reader) {
+  encoded_state_.resize(EncodedStateSize());
+  reader(encoded_state_.data(), encoded_state_.size());
+  // Decoded before the memories get read, so that they are left as is should it be corrupted.
+  State state = State();
+  Decode(encoded_state_.data(), &state);
+  for (auto* const memory : Memories()) reader(memory->Size() > 0 ? memory->Data() : nullptr, memory->Size());
+  Load(state);
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::PowerCycle() {
+  for (auto* const memory : Memories()) {
+    if (memory == rom->chips->prg_ram.get() && rom->header->ContainsPersistentMemory()) continue;
+    if (memory->Size() > 0) std::fill_n(memory->Data(), memory->Size(), 0x00);
+  }
+  rom->mapper->Reset();
+  Load(power_on_);
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::SoftReset() {
+  CatchUp();
+  cpu->Reset();
+  dma->Reset();
+  rom->mapper->Reset();
+  // Written through the bus, so that the PPU takes them as any other writes.
+  cpu_bus->Write(0x2000, 0x00);
+  cpu_bus->Write(0x2001, 0x00);
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::LoadCartridge(const ROM& cartridge) {
+  // The frame handed over to the rasterizer, if any, gets composed out of the cartridge left.
+  ppu->Quiesce();
+  rom->Insert(cartridge);
+  PowerCycle();
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+std::unique_ptr<BasicNES<CpuT, PpuT, BusT, MapperT>> BasicNES<CpuT, PpuT, BusT, MapperT>::Fork() {
+  CatchUp();
+  auto fork = std::make_unique<BasicNES>(ROMFactory::NROM(*rom));
+  fork->ppu->SkipOutput(true);
+  State state = State();
+  Save(&state);
+  // The VRAM is the only memory of the machine itself apart from the State.
+  ::Copy(*ppu_bus->BankAt(0x2000), fork->ppu_bus->BankAt(0x2000)->Data());
+  fork->Load(state);
+  if (worker_) Own();
+  return fork;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Save(State* const state) const {
+  state->cycle        = cycle;
+  state->ppu_accessed = ppu_accessed_;
+  state->nmi          = nmi_;
+  cpu->Save(&state->cpu);
+  ppu->Save(&state->ppu);
+  dma->Save(&state->dma);
+  controller_1->Save(&state->controller_1);
+  controller_2->Save(&state->controller_2);
+  ::Copy(*cpu_bus->BankAt(0x0000), state->ram);
+  for (Address address : {0x4000, 0x4015, 0x4018}) ::Copy(*cpu_bus->BankAt(address), &state->io[address - 0x4000]);
+  ::Copy(*ppu_bus->BankAt(0x3F00), state->palette);
+  std::copy_n(ppu_chips->oam->Data(), sizeof(state->oam), state->oam);
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+void BasicNES<CpuT, PpuT, BusT, MapperT>::Load(const State& state) {
+  // Memories go first, so that the PPU rebuilds its caches out of them.
+  ::Restore(cpu_bus->BankAt(0x0000), state.ram);
+  for (Address address : {0x4000, 0x4015, 0x4018}) ::Restore(cpu_bus->BankAt(address), &state.io[address - 0x4000]);
+  ::Restore(ppu_bus->BankAt(0x3F00), state.palette);
+  // OAM is written through, so as to index the scanline collisions.
+  for (Address address = 0x00; address < 0x100; address++) ppu_chips->oam->Write(address, state.oam[address]);
+  // Chips shared with forks get copied once written out of the bus, e.g., by LoadState, and the
+  // pages the PPU fetches from along with them.
+  ppu->Remap();
+  cpu->Load(state.cpu);
+  ppu->Load(state.ppu);
+  dma->Load(state.dma);
+  controller_1->Load(state.controller_1);
+  controller_2->Load(state.controller_2);
+  cycle         = state.cycle;
+  ppu_accessed_ = state.ppu_accessed;
+  nmi_          = state.nmi;
+  ppu_pending_  = 0;
+}
+
+template <typename CpuT, typename PpuT, typename BusT, typename MapperT>
+std::array<MemoryBank*, 3> BasicNES<CpuT, PpuT, BusT, MapperT>::Memories() const {
+  return {ppu_bus->BankAt(0x2000), rom->chips->prg_ram.get(), rom->chips->chr_ram.get()};
+}
+
+std::size_t NESBase::EncodedStateSize() {
+  static const std::size_t size = []() {
+    const State state = State();
+    Sizer sizer;
+    ::Visit(state, sizer);
+    return sizer.size;
+  }();
+  return size;
+}
+
+void NESBase::Encode(const State& state, Byte* const data) {
+  Encoder encoder(data);
+  ::Visit(state, encoder);
+}
+
+void NESBase::Decode(const Byte* const data, State* const state) {
+  Decoder decoder(data);
+  ::Visit(*state, decoder);
+  if (state->cpu.num_steps > CPU::State::kMaxSteps || state->ppu.num_sprites > PPU::kNumSprites)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted state specified to nesdev::core::NESBase::Decode"));
+  // Dots run from 0 through 340 on scanlines from -1, i.e., the pre-render line, through 260.
+  if (state->ppu.cycle < 0 || state->ppu.cycle > 340 || state->ppu.scanline < -1 || state->ppu.scanline > 260)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted state specified to nesdev::core::NESBase::Decode"));
+}
+
+static_assert(std::is_trivially_copyable_v<NESBase::State>, "Snapshots must be plain data");
+
+template class BasicNES<CPU, PPU, MMU, ROM::Mapper>;
+
+template class BasicNES<detail::RP2A03, detail::RP2C02, detail::MMU, detail::roms::Mapper000>;
+
 }  // namespace core
 }  // namespace nesdev
@@ -0,0 +1,78 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <utility>
+#include "nesdev/core/exceptions.h"
+#include "nesdev/core/netplay.h"
+
+namespace nesdev {
+namespace core {
+
+Loopback::Loopback(std::size_t delay)
+  : delay_{delay},
+    ends_{Endpoint(this, 0), Endpoint(this, 1)} {}
+
+Transport* Loopback::End(std::size_t player) {
+  if (player > 1)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Invalid player specified to nesdev::core::Loopback"));
+  return &ends_[player];
+}
+
+void Loopback::Tick() {
+  ticks_++;
+}
+
+void Loopback::Endpoint::Send(const Input& input) {
+  loopback_->queues_[1 - player_].push_back({loopback_->ticks_ + loopback_->delay_, input});
+}
+
+bool Loopback::Endpoint::Receive(Input* const input) {
+  auto& queue = loopback_->queues_[player_];
+  if (queue.empty() || queue.front().due > loopback_->ticks_) return false;
+  *input = queue.front().input;
+  queue.pop_front();
+  return true;
+}
+
+Rollback::Rollback(Transport* const transport, std::size_t player, std::size_t window)
+  : transport_{transport},
+    player_{player},
+    window_{window} {
+  if (player > 1)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Invalid player specified to nesdev::core::Rollback"));
+  if (window == 0)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Invalid window specified to nesdev::core::Rollback"));
+}
+
+void Rollback::Receive() {
+  Transport::Input input;
+  while (transport_->Receive(&input)) {
+    if (input.frame != confirmed_ + received_.size())
+      NESDEV_CORE_THROW(InvalidOperation::Occur("Input out of order specified to nesdev::core::Rollback"));
+    received_.push_back(input.buttons);
+  }
+}
+
+void Rollback::Confirm(std::size_t frames) {
+  if (frames == 0) return;
+  prediction_ = received_[frames - 1];
+  for (std::size_t i = 0; i < frames; i++) {
+    free_.push_back(std::move(pending_.front().snapshot));
+    pending_.pop_front();
+    received_.pop_front();
+  }
+  confirmed_ += frames;
+}
+
+std::vector<Byte> Rollback::Recycle() {
+  if (free_.empty()) return {};
+  auto snapshot = std::move(free_.back());
+  free_.pop_back();
+  return snapshot;
+}
+
+}  // namespace core
+}  // namespace nesdev
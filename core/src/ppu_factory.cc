@@ -9,6 +9,8 @@
 #include "nesdev/core/ppu_factory.h"
 #include "nesdev/core/mmu.h"
 #include "nesdev/core/palettes.h"
+#include "nesdev/core/rom.h"
+#include "detail/rasterizer.h"
 #include "detail/rp2c02.h"
 
 namespace nesdev {
@@ -26,5 +28,19 @@ std::unique_ptr<PPU> PPUFactory::RP2C02(PPU::Chips* const chips,
     Palettes::RP2C02());
 }
 
+std::unique_ptr<PPU> PPUFactory::ThreadedRP2C02(PPU::Chips* const chips,
+                                                PPU::Registers* const registers,
+                                                PPU::Shifters* const shifters,
+                                                MMU* const mmu,
+                                                ROM* const rom) {
+  return std::make_unique<detail::RP2C02>(
+    chips,
+    registers,
+    shifters,
+    mmu,
+    Palettes::RP2C02(),
+    std::make_unique<detail::Rasterizer>(rom, Palettes::RP2C02()));
+}
+
 }  // namespace core
 }  // namespace nesdev
@@ -0,0 +1,124 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <algorithm>
+#include <utility>
+#include "nesdev/core/exceptions.h"
+#include "nesdev/core/rewind.h"
+#include "nesdev/core/snapshot.h"
+#include "nesdev/core/types.h"
+
+namespace {
+
+using namespace nesdev::core;
+
+void XOR(const Byte* const lhs, const Byte* const rhs, Byte* const out, std::size_t size) {
+  for (std::size_t i = 0; i < size; i++) out[i] = lhs[i] ^ rhs[i];
+}
+
+}
+
+namespace nesdev {
+namespace core {
+
+Rewind::Rewind(std::size_t budget, std::size_t interval, std::size_t keyframe_interval)
+  : budget_{budget},
+    interval_{interval},
+    keyframe_interval_{keyframe_interval} {
+  if (interval == 0 || keyframe_interval == 0)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Invalid interval specified to nesdev::core::Rewind"));
+}
+
+void Rewind::Clear() {
+  entries_.clear();
+  usage_          = 0;
+  since_keyframe_ = 0;
+  frames_         = 0;
+}
+
+void Rewind::Push() {
+  const std::size_t size = current_.size();
+  const bool keyframe = entries_.empty() || since_keyframe_ >= keyframe_interval_ || latest_.size() != size;
+  Entry entry{keyframe, {}};
+  if (!free_.empty()) {
+    entry.data = std::move(free_.back());
+    free_.pop_back();
+  }
+  if (keyframe) {
+    Snapshot::Compress(current_.data(), size, &entry.data);
+  } else {
+    delta_.resize(size);
+    ::XOR(current_.data(), latest_.data(), delta_.data(), size);
+    Snapshot::Compress(delta_.data(), size, &entry.data);
+  }
+  usage_ += entry.data.size();
+  entries_.push_back(std::move(entry));
+  since_keyframe_ = keyframe ? 1 : since_keyframe_ + 1;
+  std::swap(latest_, current_);
+  Evict();
+}
+
+bool Rewind::Pop() {
+  if (entries_.empty()) return false;
+  std::swap(current_, latest_);
+  Entry entry = std::move(entries_.back());
+  entries_.pop_back();
+  usage_ -= entry.data.size();
+  if (entries_.empty()) {
+    since_keyframe_ = 0;
+  } else if (entry.keyframe) {
+    Replay();
+  } else {
+    // XORing the delta back gives the snapshot it has been taken against.
+    const std::size_t size = current_.size();
+    delta_.resize(size);
+    latest_.resize(size);
+    Snapshot::Decompress(entry.data.data(), entry.data.size(), delta_.data(), size);
+    ::XOR(current_.data(), delta_.data(), latest_.data(), size);
+    since_keyframe_--;
+  }
+  Recycle(&entry);
+  return true;
+}
+
+void Rewind::Evict() {
+  while (usage_ > budget_) {
+    const auto next = std::find_if(entries_.begin() + 1, entries_.end(), [](const Entry& entry) { return entry.keyframe; });
+    if (next == entries_.end()) {
+      // The only keyframe left cannot be dropped until another one gets taken.
+      since_keyframe_ = keyframe_interval_;
+      return;
+    }
+    for (auto count = next - entries_.begin(); count > 0; count--) {
+      usage_ -= entries_.front().data.size();
+      Recycle(&entries_.front());
+      entries_.pop_front();
+    }
+  }
+}
+
+void Rewind::Replay() {
+  const std::size_t size = current_.size();
+  const auto keyframe = std::find_if(entries_.rbegin(), entries_.rend(), [](const Entry& entry) { return entry.keyframe; }).base() - 1;
+  latest_.resize(size);
+  delta_.resize(size);
+  Snapshot::Decompress(keyframe->data.data(), keyframe->data.size(), latest_.data(), size);
+  for (auto entry = keyframe + 1; entry != entries_.end(); entry++) {
+    Snapshot::Decompress(entry->data.data(), entry->data.size(), delta_.data(), size);
+    ::XOR(latest_.data(), delta_.data(), latest_.data(), size);
+  }
+  since_keyframe_ = entries_.end() - keyframe;
+}
+
+void Rewind::Recycle(Entry* const entry) {
+  // Evictions drop a keyframe along with its deltas at once, which subsequent snapshots reuse.
+  if (free_.size() >= keyframe_interval_) return;
+  entry->data.clear();
+  free_.push_back(std::move(entry->data));
+}
+
+}  // namespace core
+}  // namespace nesdev
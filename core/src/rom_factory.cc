@@ -20,6 +20,19 @@
 #include "detail/roms/nrom.h"
 #include "detail/roms/mapper000.h"
 
+namespace {
+
+using namespace nesdev::core;
+
+template <Address From, Address To>
+std::unique_ptr<MemoryBank> Share(const MemoryBank& chip) {
+  if (const auto* const shared = dynamic_cast<const detail::memory_banks::Chip<From, To>*>(&chip)) return shared->Share();
+  if (dynamic_cast<const detail::memory_banks::Void*>(&chip)) return std::make_unique<detail::memory_banks::Void>();
+  NESDEV_CORE_THROW(InvalidROM::Occur("Incompatible cartridge specified to nesdev::core::ROMFactory::NROM"));
+}
+
+}
+
 namespace nesdev {
 namespace core {
 
@@ -63,5 +76,22 @@ std::unique_ptr<ROM> ROMFactory::NROM(std::istream& is) {
   return std::make_unique<detail::roms::NROM>(std::move(header), std::move(chips), std::move(mapper));
 }
 
+std::unique_ptr<ROM> ROMFactory::NROM(const ROM& rom) {
+  if (!dynamic_cast<const detail::roms::NROM*>(&rom))
+    NESDEV_CORE_THROW(InvalidROM::Occur("Incompatible cartridge specified to nesdev::core::ROMFactory::NROM"));
+
+  std::unique_ptr<ROM::Header> header = std::make_unique<ROM::Header>(*rom.header);
+
+  std::unique_ptr<ROM::Chips> chips = std::make_unique<ROM::Chips>(
+    ::Share<0x0000, 0x1FFF>(*rom.chips->chr_rom),
+    ::Share<0x0000, 0x1FFF>(*rom.chips->chr_ram),
+    ::Share<0x8000, 0xFFFF>(*rom.chips->prg_rom),
+    ::Share<0x6000, 0x7FFF>(*rom.chips->prg_ram));
+
+  std::unique_ptr<ROM::Mapper> mapper = std::make_unique<detail::roms::Mapper000>(header.get(), chips.get());
+
+  return std::make_unique<detail::roms::NROM>(std::move(header), std::move(chips), std::move(mapper), rom.Hash());
+}
+
 }  // namespace core
 }  // namespace nesdev
@@ -0,0 +1,311 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <utility>
+#include "nesdev/core/exceptions.h"
+#include "nesdev/core/macros.h"
+#include "nesdev/core/snapshot.h"
+#include "nesdev/core/types.h"
+
+namespace {
+
+using namespace nesdev::core;
+
+// Matches shorter than 4 bytes never pay for their offsets.
+constexpr std::size_t kMinMatch = 4;
+
+constexpr std::size_t kMaxOffset = 0xFFFF;
+
+constexpr std::size_t kHashBits = 12;
+
+constexpr char kMagic[4] = {'N', 'E', 'S', 'S'};
+
+std::size_t HashAt(const Byte* const data) {
+  std::uint32_t word;
+  std::memcpy(&word, data, sizeof(word));
+  return (word * 2654435761u) >> (32 - kHashBits);
+}
+
+void PutLength(std::size_t length, std::vector<Byte>* const out) {
+  for (; length >= 0xFF; length -= 0xFF) out->push_back(0xFF);
+  out->push_back(static_cast<Byte>(length));
+}
+
+/*
+ * Emits a sequence, i.e., a token, literals and a match, the last of which comes without match.
+ */
+void Emit(const Byte* const literals, std::size_t num_literals, std::size_t offset, std::size_t length, std::vector<Byte>* const out) {
+  const std::size_t extra = length > 0 ? length - kMinMatch : 0;
+  out->push_back(static_cast<Byte>((std::min<std::size_t>(num_literals, 0x0F) << 4) | std::min<std::size_t>(extra, 0x0F)));
+  if (num_literals >= 0x0F) ::PutLength(num_literals - 0x0F, out);
+  out->insert(out->end(), literals, literals + num_literals);
+  if (length == 0) return;
+  out->push_back(static_cast<Byte>(offset & 0xFF));
+  out->push_back(static_cast<Byte>(offset >> 8));
+  if (extra >= 0x0F) ::PutLength(extra - 0x0F, out);
+}
+
+template <typename T>
+void Put(T value, Byte* const out) {
+  for (std::size_t i = 0; i < sizeof(T); i++) out[i] = static_cast<Byte>(value >> (i * 8));
+}
+
+template <typename T>
+T Get(const Byte* const in) {
+  T value = 0;
+  for (std::size_t i = 0; i < sizeof(T); i++) value |= static_cast<T>(in[i]) << (i * 8);
+  return value;
+}
+
+void ReadExactly(std::istream& is, Byte* const data, std::size_t size) {
+  is.read(reinterpret_cast<char*>(data), size);
+  if (static_cast<std::size_t>(is.gcount()) != size)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Truncated snapshot specified to nesdev::core::Snapshot"));
+}
+
+struct StreamSource {
+  Byte Next() {
+    const auto byte = is.get();
+    if (byte == std::istream::traits_type::eof())
+      NESDEV_CORE_THROW(InvalidOperation::Occur("Truncated snapshot specified to nesdev::core::Snapshot::Decompress"));
+    return static_cast<Byte>(byte);
+  }
+
+  // Literals are read right in place.
+  void Read(Byte* const data, std::size_t size) {
+    ::ReadExactly(is, data, size);
+  }
+
+  std::istream& is;
+};
+
+struct MemorySource {
+  Byte Next() {
+    return *in++;
+  }
+
+  void Read(Byte* const data, std::size_t size) {
+    std::copy_n(in, size, data);
+    in += size;
+  }
+
+  const Byte* in;
+};
+
+/*
+ * Decompresses the specified number of bytes off the specified source, which is never read beyond.
+ */
+template <typename Source>
+void Inflate(Source* const source, std::size_t compressed, Byte* const data, std::size_t size) {
+  std::size_t in  = 0;
+  std::size_t out = 0;
+  auto next = [source, &in, compressed]() {
+    if (in++ >= compressed) NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted snapshot specified to nesdev::core::Snapshot::Decompress"));
+    return source->Next();
+  };
+  auto length = [&next](std::size_t length) {
+    if (length < 0x0F) return length;
+    for (Byte byte = 0xFF; byte == 0xFF; length += byte) byte = next();
+    return length;
+  };
+  while (true) {
+    const Byte token = next();
+    const std::size_t num_literals = length(token >> 4);
+    if (num_literals > size - out || num_literals > compressed - in)
+      NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted snapshot specified to nesdev::core::Snapshot::Decompress"));
+    if (num_literals > 0) source->Read(&data[out], num_literals);
+    in  += num_literals;
+    out += num_literals;
+    if (in == compressed) break;
+    const std::size_t lo     = next();
+    const std::size_t offset = lo | (next() << 8);
+    const std::size_t match  = length(token & 0x0F) + kMinMatch;
+    if (offset == 0 || offset > out || match > size - out)
+      NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted snapshot specified to nesdev::core::Snapshot::Decompress"));
+    // Matches may overlap themselves, hence copied byte by byte.
+    for (std::size_t i = 0; i < match; i++, out++) data[out] = data[out - offset];
+  }
+  if (out != size) NESDEV_CORE_THROW(InvalidOperation::Occur("Corrupted snapshot specified to nesdev::core::Snapshot::Decompress"));
+}
+
+void WriteExactly(int fd, const Byte* data, std::size_t size) {
+  while (size > 0) {
+    const auto written = ::write(fd, data, size);
+    if (written < 0 && errno == EINTR) continue;
+    if (written < 0)
+      NESDEV_CORE_THROW(InvalidOperation::Occur(std::string("Failed to write snapshot: ") + std::strerror(errno)));
+    data += written;
+    size -= written;
+  }
+}
+
+}
+
+namespace nesdev {
+namespace core {
+
+std::size_t Snapshot::Compress(const Byte* const data, std::size_t size, std::vector<Byte>* const out) {
+  const std::size_t begin = out->size();
+  // Positions are stored off by one, so that zero stands for none.
+  std::array<std::uint32_t, 1 << kHashBits> table = {};
+  std::size_t anchor = 0;
+  std::size_t pos = 0;
+  while (pos + kMinMatch <= size) {
+    const auto hash = ::HashAt(&data[pos]);
+    const std::size_t candidate = table[hash];
+    table[hash] = static_cast<std::uint32_t>(pos + 1);
+    if (candidate == 0 || pos - (candidate - 1) > kMaxOffset || std::memcmp(&data[candidate - 1], &data[pos], kMinMatch) != 0) {
+      pos++;
+      continue;
+    }
+    const std::size_t from = candidate - 1;
+    std::size_t length = kMinMatch;
+    while (pos + length < size && data[from + length] == data[pos + length]) length++;
+    ::Emit(data + anchor, pos - anchor, pos - from, length, out);
+    pos   += length;
+    anchor = pos;
+  }
+  ::Emit(data + anchor, size - anchor, 0, 0, out);
+  return out->size() - begin;
+}
+
+void Snapshot::Decompress(std::istream& is, std::size_t compressed, Byte* const data, std::size_t size) {
+  ::StreamSource source{is};
+  ::Inflate(&source, compressed, data, size);
+}
+
+void Snapshot::Decompress(const Byte* const compressed, std::size_t compressed_size, Byte* const data, std::size_t size) {
+  ::MemorySource source{compressed};
+  ::Inflate(&source, compressed_size, data, size);
+}
+
+Snapshot::Reader::Reader(std::istream& is, std::uint64_t rom_hash)
+  : is_{is} {
+  Byte header[kHeaderSize];
+  ::ReadExactly(is_, header, sizeof(header));
+  if (!std::equal(std::begin(kMagic), std::end(kMagic), header))
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Incompatible file format specified to nesdev::core::Snapshot::Load"));
+  if (::Get<std::uint32_t>(&header[4]) != kVersion)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Incompatible version specified to nesdev::core::Snapshot::Load"));
+  if (::Get<std::uint64_t>(&header[8]) != rom_hash)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Snapshot of another cartridge specified to nesdev::core::Snapshot::Load"));
+  if (::Get<std::uint32_t>(&header[16]) != kNumChunks)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Incompatible chunks specified to nesdev::core::Snapshot::Load"));
+}
+
+void Snapshot::Reader::Read(Byte* const data, std::size_t size) {
+  Byte header[kChunkHeaderSize];
+  ::ReadExactly(is_, header, sizeof(header));
+  if (chunk_ >= kNumChunks || !std::equal(std::begin(kTags[chunk_]), std::end(kTags[chunk_]), header) || ::Get<std::uint32_t>(&header[4]) != size)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Snapshot does not match the machine specified to nesdev::core::Snapshot::Load"));
+  Decompress(is_, ::Get<std::uint32_t>(&header[8]), data, size);
+  chunk_++;
+}
+
+SnapshotWriter::SnapshotWriter()
+  : worker_{&SnapshotWriter::Run, this} {}
+
+SnapshotWriter::~SnapshotWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  ready_.notify_one();
+  worker_.join();
+}
+
+void SnapshotWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this]() { return queue_.empty() && !busy_; });
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+SnapshotWriter::Job SnapshotWriter::Acquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+  if (free_.empty()) return {};
+  Job job = std::move(free_.back());
+  free_.pop_back();
+  return job;
+}
+
+void SnapshotWriter::Enqueue(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(job));
+  }
+  ready_.notify_one();
+}
+
+void SnapshotWriter::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_.wait(lock, [this]() { return !queue_.empty() || stop_; });
+    // Jobs queued before stopping get written nonetheless.
+    if (queue_.empty()) return;
+    Job job = std::move(queue_.front());
+    queue_.pop_front();
+    busy_ = true;
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      Persist(job);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !error_) error_ = error;
+    job.data.clear();
+    job.sizes.clear();
+    free_.push_back(std::move(job));
+    busy_ = false;
+    idle_.notify_all();
+  }
+}
+
+void SnapshotWriter::Persist(const Job& job) {
+  compressed_.resize(Snapshot::kHeaderSize);
+  std::copy(std::begin(kMagic), std::end(kMagic), &compressed_[0]);
+  ::Put<std::uint32_t>(Snapshot::kVersion, &compressed_[4]);
+  ::Put<std::uint64_t>(job.rom_hash, &compressed_[8]);
+  ::Put<std::uint32_t>(static_cast<std::uint32_t>(job.sizes.size()), &compressed_[16]);
+  std::size_t offset = 0;
+  for (std::size_t chunk = 0; chunk < job.sizes.size(); chunk++) {
+    const std::size_t header = compressed_.size();
+    compressed_.resize(header + Snapshot::kChunkHeaderSize);
+    const std::size_t size = Snapshot::Compress(job.data.data() + offset, job.sizes[chunk], &compressed_);
+    std::copy(std::begin(Snapshot::kTags[chunk]), std::end(Snapshot::kTags[chunk]), &compressed_[header]);
+    ::Put<std::uint32_t>(static_cast<std::uint32_t>(job.sizes[chunk]), &compressed_[header + 4]);
+    ::Put<std::uint32_t>(static_cast<std::uint32_t>(size), &compressed_[header + 8]);
+    offset += job.sizes[chunk];
+  }
+  // Written aside and renamed once synced, so that the previous file survives a crash.
+  const std::string temporary = job.path + ".tmp";
+  const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Failed to open " + temporary + ": " + std::strerror(errno)));
+  try {
+    ::WriteExactly(fd, compressed_.data(), compressed_.size());
+    if (::fsync(fd) != 0)
+      NESDEV_CORE_THROW(InvalidOperation::Occur("Failed to sync " + temporary + ": " + std::strerror(errno)));
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  if (::close(fd) != 0 || std::rename(temporary.c_str(), job.path.c_str()) != 0)
+    NESDEV_CORE_THROW(InvalidOperation::Occur("Failed to write " + job.path + ": " + std::strerror(errno)));
+}
+
+}  // namespace core
+}  // namespace nesdev
@@ -80,6 +80,27 @@ TEST_F(Mapper000Test, WriteWithValidAddress) {
   EXPECT_EQ(byte, mapper1.Read(ROM::Mapper::Space::CPU, address));
 }
 
+TEST_F(Mapper000Test, PageAt) {
+  for (auto chips : {mock_void_chr_rom_chips_.get(), mock_fill_chr_rom_chips_.get()}) {
+    auto mapper = detail::roms::Mapper000(header_.get(), chips);
+    auto address = Utility::RandomAddress<0x6000, 0x7FFF>();
+    auto byte    = Utility::RandomByte<0x00, 0xFF>();
+    mapper.Write(ROM::Mapper::Space::CPU, address, byte);
+    EXPECT_EQ(byte, mapper.PageAt(ROM::Mapper::Space::CPU, address)[address & 0x03FF]);
+    // PRG-ROM ignores writes.
+    address = Utility::RandomAddress<0x8000, 0xFFFF>();
+    byte    = mapper.Read(ROM::Mapper::Space::CPU, address);
+    mapper.Write(ROM::Mapper::Space::CPU, address, ~byte);
+    EXPECT_EQ(byte, mapper.PageAt(ROM::Mapper::Space::CPU, address)[address & 0x03FF]);
+    address = Utility::RandomAddress<0x0000, 0x1FFF>();
+    byte    = Utility::RandomByte<0x00, 0xFF>();
+    mapper.Write(ROM::Mapper::Space::PPU, address, byte);
+    EXPECT_EQ(byte, mapper.PageAt(ROM::Mapper::Space::PPU, address)[address & 0x03FF]);
+    EXPECT_EQ(nullptr, mapper.PageAt(ROM::Mapper::Space::CPU, Utility::RandomAddress<0x0000, 0x5FFF>()));
+    EXPECT_EQ(nullptr, mapper.PageAt(ROM::Mapper::Space::PPU, Utility::RandomAddress<0x2000, 0xFFFF>()));
+  }
+}
+
 //TEST_F(Mapper000Test, WriteWithInvalidAddress) {
 //  auto mapper0 = detail::roms::Mapper000(header_.get(), mock_void_chr_rom_chips_.get());
 //  auto address = Utility::RandomAddress<0x8000, 0xFFFF>();
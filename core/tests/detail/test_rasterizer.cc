@@ -0,0 +1,84 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nesdev/core.h>
+#include "detail/rasterizer.h"
+#include "utils.h"
+
+namespace nesdev {
+namespace core {
+namespace detail {
+
+class RasterizerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Utility::Init();
+    start_time_ = time(nullptr);
+    std::ifstream ifs(donkey_kong_, std::ifstream::binary);
+    rom_ = ROMFactory::NROM(ifs);
+    rasterizer_ = std::make_unique<Rasterizer>(rom_.get(), Palettes::RP2C02());
+  }
+
+  void TearDown() override {
+    rasterizer_.reset();
+    const time_t end_time = time(nullptr);
+    EXPECT_TRUE(end_time - start_time_ <= 5) << "The test took too long";
+  }
+
+  void Frame(std::size_t dots) {
+    for (std::size_t dot = 0; dot < dots; dot++) rasterizer_->Ticked();
+  }
+
+  time_t start_time_;
+
+  std::string donkey_kong_ = "core/tests/data/donkey_kong.nes";
+
+  std::unique_ptr<ROM> rom_;
+
+  std::unique_ptr<Rasterizer> rasterizer_;
+};
+
+TEST_F(RasterizerTest, Commit) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  std::size_t pixels = 0;
+  auto writer = [&framebuffer, &pixels](std::int16_t x, std::int16_t y, ARGB argb) {
+    framebuffer[y * PPU::kFrameW + x] = argb;
+    pixels++;
+  };
+  auto colour = Utility::RandomByte<0x01, 0x3F>();
+  rasterizer_->Record(Rasterizer::Event::Kind::WRITE, 0x2006, 0x3F);
+  rasterizer_->Record(Rasterizer::Event::Kind::WRITE, 0x2006, 0x00);
+  rasterizer_->Record(Rasterizer::Event::Kind::WRITE, 0x2007, colour);
+
+  // The first frame gets delivered along with the second one.
+  Frame(240 * 341);
+  rasterizer_->Commit(false, writer);
+  EXPECT_EQ(0u, pixels);
+  Frame(262 * 341);
+  rasterizer_->Commit(false, writer);
+  EXPECT_EQ(static_cast<std::size_t>(PPU::kFrameW * PPU::kFrameH), pixels);
+  const auto expected = PPU::Colours(Palettes::RP2C02()).Get(0x00, colour);
+  for (auto argb : framebuffer) EXPECT_EQ(expected, argb);
+
+  // Skipped frames are not delivered.
+  pixels = 0;
+  Frame(262 * 341);
+  rasterizer_->Commit(true, writer);
+  EXPECT_EQ(static_cast<std::size_t>(PPU::kFrameW * PPU::kFrameH), pixels);
+  pixels = 0;
+  Frame(262 * 341);
+  rasterizer_->Commit(false, writer);
+  EXPECT_EQ(0u, pixels);
+}
+
+}  // namespace detail
+}  // namespace core
+}  // namespace nesdev
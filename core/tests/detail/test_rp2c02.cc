@@ -0,0 +1,413 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nesdev/core.h>
+#include "detail/rp2c02.h"
+#include "utils.h"
+#include "mocks/mmu.h"
+
+namespace nesdev {
+namespace core {
+namespace detail {
+
+class RP2C02Test : public testing::Test {
+ protected:
+  void SetUp() override {
+    Utility::Init();
+    start_time_ = time(nullptr);
+    // Move all sprites out of the frame.
+    for (auto i = 0x0000u; i <= 0x00FFu; i += 4) chips_.oam->Write(i, 0xFF);
+  }
+
+  void TearDown() override {
+    const time_t end_time = time(nullptr);
+    EXPECT_TRUE(end_time - start_time_ <= 5) << "The test took too long";
+  }
+
+  void Sprite(std::size_t entry, Byte y, Byte id, Byte attr, Byte x) {
+    chips_.oam->Write(4 * entry + 0, y);
+    chips_.oam->Write(4 * entry + 1, id);
+    chips_.oam->Write(4 * entry + 2, attr);
+    chips_.oam->Write(4 * entry + 3, x);
+  }
+
+  time_t start_time_;
+
+  std::string donkey_kong_ = "core/tests/data/donkey_kong.nes";
+
+  mocks::MMU mmu_;
+
+  PPU::Chips chips_{std::make_unique<PPU::ObjectAttributeMap<>>()};
+
+  PPU::Registers registers_;
+
+  PPU::Shifters shifters_;
+
+  detail::RP2C02 rp2c02_{&chips_, &registers_, &shifters_, &mmu_, Palettes::RP2C02()};
+};
+
+TEST_F(RP2C02Test, EvaluateSpAt) {
+  auto y = Utility::RandomByte<0x00, 0xE0>();
+  Sprite(5, y, 0x11, 0x22, 0x33);
+  Sprite(9, y, 0x44, 0x55, 0x66);
+  rp2c02_.EvaluateSpAt(y);
+  EXPECT_EQ(2, rp2c02_.context_.num_sprites);
+  EXPECT_EQ(0x11, rp2c02_.context_.sprite[0].id);
+  EXPECT_EQ(0x66, rp2c02_.context_.sprite[1].x);
+  EXPECT_FALSE(rp2c02_.shift_.may_sprite_zero_hit_);
+  EXPECT_FALSE(registers_.ppustatus.sprite_overflow);
+
+  rp2c02_.EvaluateSpAt(y + 8);
+  EXPECT_EQ(0, rp2c02_.context_.num_sprites);
+
+  registers_.ppuctrl.sprite_height = true;
+  rp2c02_.EvaluateSpAt(y + 8);
+  EXPECT_EQ(2, rp2c02_.context_.num_sprites);
+
+  Sprite(0, y + 15, 0x77, 0x88, 0x99);
+  rp2c02_.EvaluateSpAt(y + 15);
+  EXPECT_EQ(3, rp2c02_.context_.num_sprites);
+  EXPECT_EQ(0x77, rp2c02_.context_.sprite[0].id);
+  EXPECT_TRUE(rp2c02_.shift_.may_sprite_zero_hit_);
+}
+
+TEST_F(RP2C02Test, EvaluateSpAtOverflow) {
+  auto y = Utility::RandomByte<0x00, 0xE0>();
+  for (auto entry = 0u; entry < PPU::kNumSprites; entry++) Sprite(2 * entry + 1, y, entry, 0x00, 0x00);
+  rp2c02_.EvaluateSpAt(y);
+  EXPECT_EQ(8, rp2c02_.context_.num_sprites);
+  EXPECT_FALSE(registers_.ppustatus.sprite_overflow);
+
+  Sprite(63, y + 7, 0xFF, 0x00, 0x00);
+  rp2c02_.EvaluateSpAt(y + 7);
+  EXPECT_EQ(8, rp2c02_.context_.num_sprites);
+  for (auto entry = 0u; entry < PPU::kNumSprites; entry++) EXPECT_EQ(entry, rp2c02_.context_.sprite[entry].id);
+  EXPECT_TRUE(registers_.ppustatus.sprite_overflow);
+}
+
+TEST_F(RP2C02Test, GatherSpAt) {
+  auto y = Utility::RandomByte<0x00, 0xE0>();
+  // Tile 0x01 is opaque in its right half only, while tile 0x02 is opaque all over.
+  ON_CALL(mmu_, Read(testing::_)).WillByDefault(testing::Invoke([](Address address) {
+    if ((address >> 4) == 0x01) return (address & 0x08) ? 0x00 : 0x0F;
+    return 0xFF;
+  }));
+  EXPECT_CALL(mmu_, Read(testing::_)).Times(testing::AnyNumber());
+  Sprite(0, y, 0x01, 0x00, 0x10);
+  Sprite(1, y, 0x02, 0x23, 0x0C);
+  rp2c02_.EvaluateSpAt(y);
+  rp2c02_.GatherSpAt(y);
+  for (auto x = 0u; x < static_cast<unsigned>(PPU::kFrameW); x++) {
+    const auto& pixel = shifters_.sprite_line[x];
+    if (x >= 0x14 && x < 0x18) {
+      EXPECT_EQ(0x01u, pixel.pixel);
+      EXPECT_EQ(0x00u, pixel.palette);
+      EXPECT_EQ(0x00u, pixel.priority);
+      EXPECT_EQ(0x01u, pixel.sprite_zero);
+    } else if (x >= 0x0C && x < 0x14) {
+      EXPECT_EQ(0x03u, pixel.pixel);
+      EXPECT_EQ(0x03u, pixel.palette);
+      EXPECT_EQ(0x01u, pixel.priority);
+      EXPECT_EQ(0x00u, pixel.sprite_zero);
+    } else {
+      EXPECT_EQ(0x00u, pixel.value);
+    }
+  }
+
+  // Sprites get clipped at the right edge of the frame.
+  Sprite(0, y, 0x02, 0x00, 0xFC);
+  rp2c02_.EvaluateSpAt(y);
+  rp2c02_.GatherSpAt(y);
+  for (auto x = 0xFCu; x < static_cast<unsigned>(PPU::kFrameW); x++) EXPECT_EQ(0x03u, shifters_.sprite_line[x].pixel);
+  EXPECT_EQ(0x00u, shifters_.sprite_line[0x17].pixel);
+}
+
+TEST_F(RP2C02Test, Remap) {
+  std::vector<Byte> vram(0x3000);
+  for (auto& byte : vram) byte = Utility::RandomByte<0x00, 0xFF>();
+  ON_CALL(mmu_, PageAt(testing::_)).WillByDefault(testing::Invoke([&vram](Address address) {
+    return &vram[address & ~0x03FF];
+  }));
+  EXPECT_CALL(mmu_, PageAt(testing::_)).Times(0x0C);
+  rp2c02_.Remap();
+
+  // Background fetches no longer go through the bus.
+  EXPECT_CALL(mmu_, Read(testing::_)).Times(0);
+  registers_.vramaddr.value = Utility::RandomAddress<0x0000, 0x0FFF>();
+  rp2c02_.ReadBgId();
+  EXPECT_EQ(vram[0x2000 | registers_.vramaddr.value], rp2c02_.context_.background.id);
+  rp2c02_.ReadBgLSB();
+  EXPECT_EQ(vram[(rp2c02_.context_.background.id << 4) + registers_.vramaddr.fine_y], rp2c02_.context_.background.lsb);
+  rp2c02_.ReadBgMSB();
+  EXPECT_EQ(vram[(rp2c02_.context_.background.id << 4) + registers_.vramaddr.fine_y + 8], rp2c02_.context_.background.msb);
+}
+
+TEST_F(RP2C02Test, ComposeLine) {
+  std::vector<Byte> vram(0x3000);
+  for (auto& byte : vram) byte = Utility::RandomByte<0x00, 0xFF>();
+  ON_CALL(mmu_, PageAt(testing::_)).WillByDefault(testing::Invoke([&vram](Address address) {
+    return &vram[address & ~0x03FF];
+  }));
+  ON_CALL(mmu_, Read(testing::_)).WillByDefault(testing::Invoke([](Address address) {
+    return static_cast<Byte>(address & 0x3F);
+  }));
+  ON_CALL(mmu_, Write(testing::_, testing::_)).WillByDefault(testing::Invoke([&vram](Address address, Byte byte) {
+    if (address < 0x3000) vram[address] = byte;
+  }));
+  EXPECT_CALL(mmu_, PageAt(testing::_)).Times(testing::AnyNumber());
+  EXPECT_CALL(mmu_, Read(testing::_)).Times(testing::AnyNumber());
+  EXPECT_CALL(mmu_, Write(testing::_, testing::_)).Times(testing::AnyNumber());
+  for (auto entry = 0u; entry < 8; entry++)
+    Sprite(entry, Utility::RandomByte<0x00, 0xE0>(), Utility::RandomByte<0x00, 0xFF>(), Utility::RandomByte<0x00, 0xFF>(), Utility::RandomByte<0x00, 0xFF>());
+
+  // The expected PPU goes through the pipeline dot by dot.
+  PPU::Registers registers;
+  PPU::Shifters shifters;
+  detail::RP2C02 expected{&chips_, &registers, &shifters, &mmu_, Palettes::RP2C02()};
+  std::vector<ARGB> ticked(PPU::kFrameW * PPU::kFrameH, 0x00);
+  std::vector<ARGB> ran(PPU::kFrameW * PPU::kFrameH, 0x00);
+  expected.Framebuffer([&ticked](std::int16_t x, std::int16_t y, ARGB argb) { ticked[y * PPU::kFrameW + x] = argb; });
+  rp2c02_.Framebuffer([&ran](std::int16_t x, std::int16_t y, ARGB argb) { ran[y * PPU::kFrameW + x] = argb; });
+  auto write = [&expected, this](Address address, Byte byte) {
+    expected.Write(address, byte);
+    rp2c02_.Write(address, byte);
+  };
+  expected.Remap();
+  rp2c02_.Remap();
+  for (Address entry = 0x3F00; entry < 0x3F20; entry++) {
+    write(0x2006, entry >> 8);
+    write(0x2006, entry & 0xFF);
+    write(0x2007, static_cast<Byte>(entry));
+  }
+
+  for (auto frame = 0; frame < 4; frame++) {
+    // Tiles and patterns in use get rewritten in between frames.
+    for (auto i = 0; i < 16; i++) {
+      const auto address = frame % 2 ? Utility::RandomAddress<0x0000, 0x1FFF>() : Utility::RandomAddress<0x2000, 0x2FFF>();
+      write(0x2006, address >> 8);
+      write(0x2006, address & 0xFF);
+      write(0x2007, Utility::RandomByte<0x00, 0xFF>());
+    }
+    write(0x2000, Utility::RandomByte<0x00, 0xFF>() & 0x13);
+    write(0x2005, Utility::RandomByte<0x00, 0xFF>());
+    write(0x2005, Utility::RandomByte<0x00, 0xEF>());
+    write(0x2001, 0x1E);
+    for (auto dot = 0; dot < 341 * 262; dot++) expected.Tick();
+    rp2c02_.Run(341 * 262);
+    EXPECT_EQ(expected.Scanline(), rp2c02_.Scanline());
+    EXPECT_EQ(expected.VRAMAddr(), rp2c02_.VRAMAddr());
+    EXPECT_EQ(registers.ppustatus.value, registers_.ppustatus.value);
+    EXPECT_EQ(ticked, ran);
+  }
+}
+
+TEST_F(RP2C02Test, Memoize) {
+  std::vector<Byte> vram(0x3000);
+  for (auto& byte : vram) byte = Utility::RandomByte<0x00, 0xFF>();
+  ON_CALL(mmu_, PageAt(testing::_)).WillByDefault(testing::Invoke([&vram](Address address) {
+    return &vram[address & ~0x03FF];
+  }));
+  ON_CALL(mmu_, Read(testing::_)).WillByDefault(testing::Invoke([&vram](Address address) {
+    return address < 0x3000 ? vram[address] : static_cast<Byte>(address & 0x3F);
+  }));
+  ON_CALL(mmu_, Write(testing::_, testing::_)).WillByDefault(testing::Invoke([&vram](Address address, Byte byte) {
+    if (address < 0x3000) vram[address] = byte;
+  }));
+  EXPECT_CALL(mmu_, PageAt(testing::_)).Times(testing::AnyNumber());
+  EXPECT_CALL(mmu_, Read(testing::_)).Times(testing::AnyNumber());
+  EXPECT_CALL(mmu_, Write(testing::_, testing::_)).Times(testing::AnyNumber());
+  std::size_t pixels = 0;
+  rp2c02_.Framebuffer([&pixels](std::int16_t, std::int16_t, ARGB) { pixels++; });
+  rp2c02_.Remap();
+  rp2c02_.Write(0x2001, 0x1E);
+  auto run_until = [this](std::int16_t scanline, std::int16_t cycle) {
+    // Dots skipped on odd frames are not taken into account, so finish it off dot by dot.
+    rp2c02_.Run(rp2c02_.DotsUntil(scanline, cycle) - 1);
+    while (rp2c02_.Scanline() != scanline || rp2c02_.Cycle() != cycle) rp2c02_.Tick();
+  };
+  auto write_vram = [this](Address address, Byte byte) {
+    rp2c02_.Write(0x2006, address >> 8);
+    rp2c02_.Write(0x2006, address & 0xFF);
+    rp2c02_.Write(0x2007, byte);
+    // Restores the scroll.
+    rp2c02_.Write(0x2000, 0x00);
+    rp2c02_.Write(0x2005, 0x00);
+    rp2c02_.Write(0x2005, 0x00);
+  };
+  run_until(240, 0);
+  run_until(240, 0);
+  EXPECT_FALSE(rp2c02_.IsFrameUnchanged());
+
+  pixels = 0;
+  run_until(240, 0);
+  EXPECT_TRUE(rp2c02_.IsFrameUnchanged());
+  EXPECT_EQ(0u, pixels);
+
+  // Writing what is already there changes nothing.
+  const auto address = Utility::RandomAddress<0x2000, 0x23BF>();
+  write_vram(address, vram[address]);
+  run_until(240, 0);
+  EXPECT_TRUE(rp2c02_.IsFrameUnchanged());
+  EXPECT_EQ(0u, pixels);
+
+  // Nor is it told by reading through the bus, as reads latch banks on some mappers.
+  const auto pattern = Utility::RandomAddress<0x0000, 0x1FFF>();
+  EXPECT_CALL(mmu_, Read(pattern)).Times(0);
+  write_vram(pattern, vram[pattern]);
+  EXPECT_CALL(mmu_, Read(pattern)).Times(testing::AnyNumber());
+  run_until(240, 0);
+  EXPECT_TRUE(rp2c02_.IsFrameUnchanged());
+  EXPECT_EQ(0u, pixels);
+
+  // Frames after a change get written as a whole.
+  write_vram(address, vram[address] ^ 0xFF);
+  run_until(240, 0);
+  EXPECT_FALSE(rp2c02_.IsFrameUnchanged());
+  EXPECT_EQ(static_cast<std::size_t>(PPU::kFrameW * PPU::kFrameH), pixels);
+
+  // Frames changed in the middle get written from there on.
+  pixels = 0;
+  run_until(240, 0);
+  EXPECT_TRUE(rp2c02_.IsFrameUnchanged());
+  run_until(120, 0);
+  rp2c02_.Write(0x2005, 0x10);
+  run_until(240, 0);
+  EXPECT_FALSE(rp2c02_.IsFrameUnchanged());
+  EXPECT_EQ(static_cast<std::size_t>(PPU::kFrameW * (PPU::kFrameH - 120)), pixels);
+
+  // Skipped frames are not held by the writer.
+  run_until(240, 0);
+  rp2c02_.SkipOutput(true);
+  run_until(240, 0);
+  rp2c02_.SkipOutput(false);
+  pixels = 0;
+  run_until(240, 0);
+  EXPECT_FALSE(rp2c02_.IsFrameUnchanged());
+  EXPECT_EQ(static_cast<std::size_t>(PPU::kFrameW * PPU::kFrameH), pixels);
+}
+
+TEST_F(RP2C02Test, ResolvePalette) {
+  for (auto entry = 0x00u; entry < 0x20u; entry++) {
+    EXPECT_EQ(rp2c02_.Colour(0x00, 0x00), rp2c02_.shift_.palette_[entry]);
+  }
+
+  auto colour = Utility::RandomByte<0x00, 0x3F>();
+  ON_CALL(mmu_, Read(testing::_)).WillByDefault(testing::Return(0x00));
+  ON_CALL(mmu_, Read(0x3F00)).WillByDefault(testing::Return(colour));
+  ON_CALL(mmu_, Read(0x3F10)).WillByDefault(testing::Return(colour));
+  EXPECT_CALL(mmu_, Write(0x3F10, colour)).Times(1);
+  EXPECT_CALL(mmu_, Read(0x3F00)).Times(testing::AnyNumber());
+  EXPECT_CALL(mmu_, Read(0x3F10)).Times(testing::AnyNumber());
+  rp2c02_.Write(0x2006, 0x3F);
+  rp2c02_.Write(0x2006, 0x10);
+  rp2c02_.Write(0x2007, colour);
+  EXPECT_EQ(rp2c02_.Colour(0x00, colour), rp2c02_.shift_.palette_[0x00]);
+  EXPECT_EQ(rp2c02_.Colour(0x00, colour), rp2c02_.shift_.palette_[0x10]);
+  EXPECT_EQ(rp2c02_.Colour(0x00, 0x00),   rp2c02_.shift_.palette_[0x01]);
+
+  EXPECT_CALL(mmu_, Read(testing::_)).Times(0x20);
+  rp2c02_.Write(0x2001, 0x20 | 0x01);
+  EXPECT_EQ(rp2c02_.Colour(0x01, colour & 0x30), rp2c02_.shift_.palette_[0x00]);
+  EXPECT_EQ(rp2c02_.Colour(0x01, colour & 0x30), rp2c02_.shift_.palette_[0x10]);
+  EXPECT_EQ(rp2c02_.Colour(0x01, 0x00),          rp2c02_.shift_.palette_[0x1F]);
+
+  rp2c02_.Write(0x2001, 0x20 | 0x01 | 0x18);
+}
+
+TEST_F(RP2C02Test, Render) {
+  std::vector<Byte> vram(0x3000);
+  for (auto& byte : vram) byte = Utility::RandomByte<0x00, 0xFF>();
+  ON_CALL(mmu_, PageAt(testing::_)).WillByDefault(testing::Invoke([&vram](Address address) {
+    return &vram[address & ~0x03FF];
+  }));
+  EXPECT_CALL(mmu_, PageAt(testing::_)).Times(testing::AnyNumber());
+  rp2c02_.Remap();
+  for (auto entry = 0x00u; entry < 0x20u; entry++) rp2c02_.shift_.palette_[entry] = 0xFF000000 | entry;
+  auto colour = [this](Address pattern, std::size_t row, std::size_t bit, Byte palette) {
+    const Byte lsb = (rp2c02_.shift_.Fetch(pattern + row) >> bit) & 0x01;
+    const Byte msb = (rp2c02_.shift_.Fetch(pattern + row + 8) >> bit) & 0x01;
+    const Byte pix = msb << 1 | lsb;
+    return rp2c02_.shift_.palette_[pix ? palette << 2 | pix : 0x00];
+  };
+  const auto vramaddr = Utility::RandomAddress<0x0000, 0x3FFF>();
+  registers_.vramaddr.value = vramaddr;
+  registers_.ppuctrl.background_tile = true;
+  Sprite(3, 0x40, 0x21, 0xC1, 0x80);
+
+  // Views are decoded from memory, leaving the bus and registers alone.
+  EXPECT_CALL(mmu_, Read(testing::_)).Times(0);
+  EXPECT_CALL(mmu_, Write(testing::_, testing::_)).Times(0);
+  std::vector<ARGB> pixels(PPU::kNametablesW * PPU::kNametablesH);
+  const auto tile = Utility::RandomByte<0x00, 0xFF>();
+  const auto row  = Utility::RandomByte<0x00, 0x07>();
+  const auto col  = Utility::RandomByte<0x00, 0x07>();
+  rp2c02_.RenderPatternTable(1, 2, pixels.data());
+  EXPECT_EQ(colour(0x1000 | tile << 4, row, 7 - col, 2),
+            pixels[(tile / 16 * 8 + row) * PPU::kPatternTableW + tile % 16 * 8 + col]);
+
+  const std::size_t tile_x = Utility::RandomByte<0x00, 0x3F>();
+  const std::size_t tile_y = Utility::RandomByte<0x00, 0x3B>();
+  const Address nametable = 0x2000 | (tile_y / 30) << 11 | (tile_x / 32) << 10;
+  Byte attr = vram[nametable | 0x03C0 | (tile_y % 30 / 4) << 3 | (tile_x % 32 / 4)];
+  attr >>= (tile_y % 30 & 0x02) << 1 | (tile_x % 32 & 0x02);
+  rp2c02_.RenderNametables(pixels.data());
+  EXPECT_EQ(colour(0x1000 | vram[nametable | (tile_y % 30) << 5 | (tile_x % 32)] << 4, row, 7 - col, attr & 0x03),
+            pixels[(tile_y * 8 + row) * PPU::kNametablesW + tile_x * 8 + col]);
+
+  // Sprite 3 is flipped both vertically and horizontally.
+  rp2c02_.RenderSprites(pixels.data());
+  EXPECT_EQ(colour(0x21 << 4, 7 - row, col, 0x05), pixels[row * PPU::kSpritesW + 3 * 8 + col]);
+  EXPECT_EQ(rp2c02_.shift_.palette_[0x00], pixels[(8 + row) * PPU::kSpritesW + 3 * 8 + col]);
+
+  rp2c02_.RenderPalette(pixels.data());
+  for (auto entry = 0x00u; entry < 0x20u; entry++) EXPECT_EQ(0xFF000000 | entry, pixels[entry]);
+
+  EXPECT_EQ(vramaddr, rp2c02_.VRAMAddr());
+  EXPECT_FALSE(rp2c02_.latch_.is_latched_);
+}
+
+TEST_F(RP2C02Test, SkipOutput) {
+  std::ifstream ifs(donkey_kong_, std::ifstream::binary);
+  auto rom = ROMFactory::NROM(ifs);
+  // Nothing is kept in place, so that fetches go through the bus.
+  EXPECT_CALL(mmu_, PageAt(testing::_)).Times(testing::AnyNumber());
+  rp2c02_.Connect(rom.get());
+  std::size_t pixels = 0;
+  rp2c02_.Framebuffer([&pixels](std::int16_t, std::int16_t, ARGB) { pixels++; });
+  ON_CALL(mmu_, Read(testing::_)).WillByDefault(testing::Return(0x00));
+  rp2c02_.Write(0x2001, 0x18);
+  rp2c02_.SkipOutput(true);
+
+  // Nothing is fetched nor composed, while scrolling goes on.
+  EXPECT_CALL(mmu_, Read(testing::_)).Times(0);
+  for (auto dot = 0; dot < 341 * 2; dot++) rp2c02_.Tick();
+  testing::Mock::VerifyAndClearExpectations(&mmu_);
+  EXPECT_EQ(2, rp2c02_.Scanline());
+  EXPECT_EQ(2, rp2c02_.VRAMAddr() >> 12);
+  EXPECT_EQ(0u, pixels);
+
+  // Sprite 0 on the next line brings the pixel pipeline back for sprite 0 hit.
+  Sprite(0, 2, 0x00, 0x00, 0x10);
+  EXPECT_CALL(mmu_, Read(testing::_)).Times(testing::AtLeast(1));
+  for (auto dot = 0; dot < 341; dot++) rp2c02_.Tick();
+  testing::Mock::VerifyAndClearExpectations(&mmu_);
+  EXPECT_TRUE(rp2c02_.shift_.may_sprite_zero_hit_);
+  EXPECT_EQ(0u, pixels);
+
+  EXPECT_CALL(mmu_, Read(testing::_)).Times(testing::AnyNumber());
+  rp2c02_.SkipOutput(false);
+  for (auto dot = 0; dot < 341; dot++) rp2c02_.Tick();
+  EXPECT_EQ(static_cast<std::size_t>(PPU::kFrameW), pixels);
+}
+
+}  // namespace detail
+}  // namespace core
+}  // namespace nesdev
@@ -30,6 +30,10 @@ class CPU : public nesdev::core::CPU {
 
   MOCK_METHOD0(NMI, void());
 
+  MOCK_CONST_METHOD1(Save, void(State* const));
+
+  MOCK_METHOD1(Load, void(const State&));
+
   MOCK_CONST_METHOD0(PCRegister, Address());
 
   MOCK_CONST_METHOD0(ARegister, Byte());
@@ -21,6 +21,10 @@ class MMU : public nesdev::core::MMU {
   MOCK_CONST_METHOD1(Read, Byte(Address));
 
   MOCK_METHOD2(Write, void(Address, Byte));
+
+  MOCK_CONST_METHOD1(PageAt, const Byte*(Address));
+
+  MOCK_CONST_METHOD1(BankAt, MemoryBank*(Address));
 };
 
 }  // namespace mocks
@@ -25,6 +25,8 @@ class PPU : public nesdev::core::PPU {
 
   MOCK_METHOD2(Write, void(Address, Byte));
 
+  MOCK_METHOD2(WriteOAM, void(Byte, Byte));
+
   MOCK_CONST_METHOD0(IsRendering, bool());
 
   MOCK_CONST_METHOD0(CtrlRegister, Byte());
@@ -42,6 +44,18 @@ class PPU : public nesdev::core::PPU {
   MOCK_CONST_METHOD0(BgAttrLo, Address());
 
   MOCK_CONST_METHOD0(BgAttrHi, Address());
+
+  MOCK_CONST_METHOD3(RenderPatternTable, void(std::size_t, Byte, ARGB* const));
+
+  MOCK_CONST_METHOD1(RenderNametables, void(ARGB* const));
+
+  MOCK_CONST_METHOD1(RenderSprites, void(ARGB* const));
+
+  MOCK_CONST_METHOD1(RenderPalette, void(ARGB* const));
+
+  MOCK_CONST_METHOD1(Save, void(State* const));
+
+  MOCK_METHOD1(Load, void(const State&));
 };
 
 }  // namespace mocks
@@ -8,7 +8,11 @@
 #define _NESDEV_CORE_TEST_UTILS_H_
 #include <cstdlib>
 #include <ctime>
+#include <fstream>
+#include <memory>
 #include <sstream>
+#include <string>
+#include <vector>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <nesdev/core.h>
@@ -47,6 +51,22 @@ class Utility {
     return From + rand() % (To - From + 1);
   }
 
+  /*
+   * Boots the specified cartridge, drawing nowhere.
+   */
+  static std::unique_ptr<NES> Boot(const std::string& path) {
+    std::ifstream ifs(path, std::ifstream::binary);
+    auto nes = std::make_unique<NES>(ROMFactory::NROM(ifs));
+    nes->ppu->Framebuffer([](std::int16_t, std::int16_t, ARGB) {});
+    return nes;
+  }
+
+  static std::vector<Byte> Take(NES* const nes) {
+    std::vector<Byte> snapshot(nes->StateSize());
+    nes->SaveState(snapshot.data(), snapshot.size());
+    return snapshot;
+  }
+
  private:
   Utility();
 };
@@ -0,0 +1,96 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nesdev/core.h>
+#include "utils.h"
+
+namespace nesdev {
+namespace core {
+
+class BootCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Utility::Init();
+  }
+
+  std::string super_mario_brothers_ = "core/tests/data/super_mario_brothers.nes";
+};
+
+TEST_F(BootCacheTest, Boot) {
+  BootCache cache(testing::TempDir(), 30);
+  auto nes = Utility::Boot(super_mario_brothers_);
+  const std::string path = cache.PathOf(nes->rom->Hash());
+  std::remove(path.c_str());
+
+  // Misses first, leaving the machine as booted by running, whatever it has run before.
+  nes->controller_1->Buttons(0xFF);
+  nes->RunFrame();
+  EXPECT_FALSE(cache.Boot(nes.get()));
+  cache.Flush();
+  const auto booted = Utility::Take(nes.get());
+  auto expected = Utility::Boot(super_mario_brothers_);
+  for (auto frame = 0; frame < 30; frame++) expected->RunFrame();
+  EXPECT_EQ(Utility::Take(expected.get()), booted);
+  EXPECT_FALSE(nes->ppu->IsSkippingOutput());
+
+  // Hits from then on, on any machine of the cartridge, which then runs the very same way.
+  auto other = Utility::Boot(super_mario_brothers_);
+  EXPECT_TRUE(cache.Boot(other.get()));
+  EXPECT_EQ(booted, Utility::Take(other.get()));
+  nes->RunFrame();
+  other->RunFrame();
+  EXPECT_EQ(Utility::Take(nes.get()), Utility::Take(other.get()));
+
+  // Broken files are booted over.
+  std::ofstream(path, std::ofstream::binary | std::ofstream::trunc) << "NESS";
+  EXPECT_FALSE(cache.Boot(other.get()));
+  EXPECT_EQ(booted, Utility::Take(other.get()));
+  cache.Flush();
+  EXPECT_TRUE(cache.Boot(other.get()));
+  std::remove(path.c_str());
+}
+
+TEST_F(BootCacheTest, Error) {
+  BootCache cache(testing::TempDir() + "/nonexistent", 1);
+  const auto idle = [&cache]() {
+    std::unique_lock<std::mutex> lock(cache.writer_.mutex_);
+    cache.writer_.idle_.wait(lock, [&cache]() {
+      return cache.writer_.queue_.empty() && !cache.writer_.busy_;
+    });
+  };
+
+  // Errors rethrown on booting again are kept for the next flush, the boot being cached anyway.
+  auto nes = Utility::Boot(super_mario_brothers_);
+  EXPECT_FALSE(cache.Boot(nes.get()));
+  idle();
+  EXPECT_TRUE(cache.writer_.error_);
+  auto other = Utility::Boot(super_mario_brothers_);
+  EXPECT_FALSE(cache.Boot(other.get()));
+  idle();
+  EXPECT_TRUE(cache.error_);
+  EXPECT_TRUE(cache.writer_.error_);
+  EXPECT_THROW(cache.Flush(), InvalidOperation);
+  EXPECT_NO_THROW(cache.Flush());
+}
+
+TEST_F(BootCacheTest, Key) {
+  BootCache cache(testing::TempDir(), 30);
+  BootCache longer(testing::TempDir(), 60);
+  EXPECT_NE(cache.PathOf(0x01), cache.PathOf(0x02));
+  EXPECT_NE(cache.PathOf(0x01), longer.PathOf(0x01));
+  EXPECT_THROW(BootCache(testing::TempDir(), 0), InvalidOperation);
+}
+
+}  // namespace core
+}  // namespace nesdev
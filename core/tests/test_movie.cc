@@ -0,0 +1,123 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nesdev/core.h>
+#include "utils.h"
+
+namespace nesdev {
+namespace core {
+
+class MovieTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Utility::Init();
+  }
+
+  std::string donkey_kong_ = "core/tests/data/donkey_kong.nes";
+
+  std::string super_mario_brothers_ = "core/tests/data/super_mario_brothers.nes";
+};
+
+TEST_F(MovieTest, RecordAndPlay) {
+  auto nes = Utility::Boot(super_mario_brothers_);
+  // Starts off the middle of a run, which the movie takes along.
+  nes->Run(Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>());
+  Movie movie;
+  movie.Record(nes.get());
+  std::vector<std::vector<Byte>> expected;
+  for (auto frame = 0; frame < 120; frame++) {
+    // Buttons are held for a while, as players do.
+    if (frame % 8 == 0) {
+      nes->controller_1->Buttons(Utility::RandomByte<0x00, 0xFF>());
+      nes->controller_2->Buttons(Utility::RandomByte<0x00, 0xFF>());
+    }
+    movie.RecordFrame(nes.get());
+    expected.push_back(Utility::Take(nes.get()));
+  }
+  EXPECT_EQ(120u, movie.Frames());
+
+  std::stringstream ss;
+  movie.Save(ss);
+  Movie loaded;
+  loaded.Load(ss);
+  EXPECT_EQ(movie.ROMHash(), loaded.ROMHash());
+  EXPECT_EQ(movie.Frames(), loaded.Frames());
+  // Plays back the very same way, on another machine, however many times.
+  auto other = Utility::Boot(super_mario_brothers_);
+  for (auto i = 0; i < 2; i++) {
+    loaded.Play(other.get());
+    for (const auto& snapshot : expected) {
+      ASSERT_TRUE(loaded.PlayFrame(other.get()));
+      ASSERT_EQ(snapshot, Utility::Take(other.get()));
+    }
+    EXPECT_FALSE(loaded.PlayFrame(other.get()));
+    EXPECT_EQ(120u, loaded.Position());
+  }
+}
+
+TEST_F(MovieTest, RecordFromPowerOn) {
+  auto nes = Utility::Boot(super_mario_brothers_);
+  nes->Run(Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>());
+  Movie movie;
+  movie.RecordFromPowerOn(nes.get());
+  std::vector<std::vector<Byte>> expected;
+  for (auto frame = 0; frame < 60; frame++) {
+    if (frame % 8 == 0) nes->controller_1->Buttons(Utility::RandomByte<0x00, 0xFF>());
+    movie.RecordFrame(nes.get());
+    expected.push_back(Utility::Take(nes.get()));
+  }
+
+  std::stringstream ss;
+  movie.Save(ss);
+  Movie loaded;
+  loaded.Load(ss);
+  EXPECT_TRUE(loaded.FromPowerOn());
+  // Carries no state along, power cycling the machine wherever it has been run to.
+  EXPECT_TRUE(loaded.start_.empty());
+  auto other = Utility::Boot(super_mario_brothers_);
+  other->Run(Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>());
+  loaded.Play(other.get());
+  for (const auto& snapshot : expected) {
+    ASSERT_TRUE(loaded.PlayFrame(other.get()));
+    ASSERT_EQ(snapshot, Utility::Take(other.get()));
+  }
+}
+
+TEST_F(MovieTest, Refuse) {
+  auto nes = Utility::Boot(super_mario_brothers_);
+  Movie movie;
+  movie.Record(nes.get());
+  for (auto frame = 0; frame < 10; frame++) movie.RecordFrame(nes.get());
+  std::ostringstream os;
+  movie.Save(os);
+  const std::string file = os.str();
+
+  // Movies of other cartridges, other versions or truncated ones are refused.
+  auto other = Utility::Boot(donkey_kong_);
+  EXPECT_THROW(movie.Play(other.get()), InvalidOperation);
+  Movie loaded;
+  std::string another_version = file;
+  another_version[4]++;
+  std::istringstream another_version_is(another_version);
+  EXPECT_THROW(loaded.Load(another_version_is), InvalidOperation);
+  std::istringstream truncated(file.substr(0, file.size() - 1));
+  EXPECT_THROW(loaded.Load(truncated), InvalidOperation);
+  // Nor are the ones told to be from power-on while carrying a state.
+  std::string corrupted = file;
+  corrupted[20] |= 0x01;
+  std::istringstream corrupted_is(corrupted);
+  EXPECT_THROW(loaded.Load(corrupted_is), InvalidOperation);
+  EXPECT_EQ(0u, loaded.Frames());
+}
+
+}  // namespace core
+}  // namespace nesdev
@@ -0,0 +1,572 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nesdev/core.h>
+#include "detail/static_nes.h"
+#include "utils.h"
+
+namespace nesdev {
+namespace core {
+
+template <typename T>
+class NESTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Utility::Init();
+    start_time_ = time(nullptr);
+  }
+
+  void TearDown() override {
+    const time_t end_time = time(nullptr);
+    EXPECT_TRUE(end_time - start_time_ <= 5) << "The test took too long";
+  }
+
+  /*
+   * Boots Donkey Kong, whose PRG-ROM is zero-padded, running the following program from RAM:
+   * toggles rendering, writes tile 0, palettes and scrolls, polls PPUSTATUS and moves sprite 0
+   * around by OAM DMA, at various timings.
+   */
+  std::unique_ptr<T> Boot(std::vector<ARGB>* framebuffer, PPU::Rasterization rasterization = PPU::Rasterization::INLINE) {
+    std::ifstream ifs(donkey_kong_, std::ifstream::binary);
+    return Boot(ifs, framebuffer, rasterization);
+  }
+
+  /*
+   * Boots the cartridge read off the specified stream likewise.
+   */
+  std::unique_ptr<T> Boot(std::istream& is, std::vector<ARGB>* framebuffer, PPU::Rasterization rasterization = PPU::Rasterization::INLINE) {
+    auto nes = std::make_unique<T>(ROMFactory::NROM(is), rasterization);
+    const std::vector<Byte> program = {
+      0xE6, 0xF0,             // $0200: INC $F0
+      0xA5, 0xF0,             // $0202: LDA $F0
+      0x29, 0x10,             // $0204: AND #$10
+      0x09, 0x08,             // $0206: ORA #$08
+      0x8D, 0x01, 0x20,       // $0208: STA $2001
+      0xA9, 0x00,             // $020B: LDA #$00
+      0x8D, 0x06, 0x20,       // $020D: STA $2006
+      0xA5, 0xF0,             // $0210: LDA $F0
+      0x29, 0x0F,             // $0212: AND #$0F
+      0x8D, 0x06, 0x20,       // $0214: STA $2006
+      0xA5, 0xF0,             // $0217: LDA $F0
+      0x8D, 0x07, 0x20,       // $0219: STA $2007
+      0xA9, 0x3F,             // $021C: LDA #$3F
+      0x8D, 0x06, 0x20,       // $021E: STA $2006
+      0xA5, 0xF0,             // $0221: LDA $F0
+      0x8D, 0x06, 0x20,       // $0223: STA $2006
+      0x8D, 0x07, 0x20,       // $0226: STA $2007
+      0x8D, 0x05, 0x20,       // $0229: STA $2005
+      0x8D, 0x05, 0x20,       // $022C: STA $2005
+      0x0A,                   // $022F: ASL
+      0x85, 0x00,             // $0230: STA $00
+      0xAD, 0x02, 0x20,       // $0232: LDA $2002
+      0x85, 0xF1,             // $0235: STA $F1
+      0xA9, 0x00,             // $0237: LDA #$00
+      0x8D, 0x14, 0x40,       // $0239: STA $4014
+      0xA6, 0xF0,             // $023C: LDX $F0
+      0xCA,                   // $023E: DEX
+      0xD0, 0xFD,             // $023F: BNE $023E
+      0x4C, 0x00, 0x02        // $0241: JMP $0200
+    };
+    // Jumps to $0200 at reset, so that $0000-$0003 is left for sprite 0, which has its y moved.
+    nes->cpu_bus->Write(0x0000, 0x4C);
+    nes->cpu_bus->Write(0x0001, 0x00);
+    nes->cpu_bus->Write(0x0002, 0x02);
+    nes->cpu_bus->Write(0x0003, 0x10);
+    for (Address offset = 0; offset < program.size(); offset++) nes->cpu_bus->Write(0x0200 + offset, program[offset]);
+    nes->ppu->Framebuffer([framebuffer](std::int16_t x, std::int16_t y, ARGB argb) {
+      (*framebuffer)[y * PPU::kFrameW + x] = argb;
+    });
+    return nes;
+  }
+
+  time_t start_time_;
+
+  std::string donkey_kong_ = "core/tests/data/donkey_kong.nes";
+
+  std::string super_mario_brothers_ = "core/tests/data/super_mario_brothers.nes";
+};
+
+// Runs against both the virtual and the devirtualized compositions.
+using Compositions = testing::Types<NES, detail::StaticNES>;
+
+TYPED_TEST_SUITE(NESTest, Compositions, );
+
+TYPED_TEST(NESTest, Run) {
+  std::vector<ARGB> ticked(PPU::kFrameW * PPU::kFrameH, 0x00);
+  std::vector<ARGB> ran(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto expected = this->Boot(&ticked);
+  auto actual = this->Boot(&ran);
+  for (auto chunk = 0; chunk < 64; chunk++) {
+    const std::size_t dots = Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0x20>();
+    for (std::size_t dot = 0; dot < dots; dot++) expected->Tick();
+    actual->Run(dots);
+    ASSERT_EQ(expected->cycle, actual->cycle);
+    ASSERT_EQ(expected->ppu->Scanline(), actual->ppu->Scanline());
+    ASSERT_EQ(expected->ppu->Cycle(), actual->ppu->Cycle());
+    ASSERT_EQ(expected->ppu_registers->ppustatus.value, actual->ppu_registers->ppustatus.value);
+    ASSERT_EQ(expected->ppu->VRAMAddr(), actual->ppu->VRAMAddr());
+    ASSERT_EQ(expected->cpu->PCRegister(), actual->cpu->PCRegister());
+    ASSERT_EQ(expected->cpu->ARegister(), actual->cpu->ARegister());
+    ASSERT_EQ(expected->cpu_bus->Read(0x00F1), actual->cpu_bus->Read(0x00F1));
+    ASSERT_EQ(ticked, ran);
+  }
+}
+
+TYPED_TEST(NESTest, RunFrame) {
+  std::vector<ARGB> ticked(PPU::kFrameW * PPU::kFrameH, 0x00);
+  std::vector<ARGB> ran(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto expected = this->Boot(&ticked);
+  auto actual = this->Boot(&ran);
+  for (auto frame = 0; frame < 8; frame++) {
+    do expected->Tick(); while (!(expected->ppu->IsPostRenderLine() && expected->ppu->Cycle() == 0));
+    ASSERT_EQ(NESBase::Status::FRAME, actual->RunFrame());
+    ASSERT_EQ(expected->cycle, actual->cycle);
+    ASSERT_EQ(expected->cpu->PCRegister(), actual->cpu->PCRegister());
+    ASSERT_EQ(ticked, ran);
+  }
+
+  // Frames do not complete within a budget shorter than a frame.
+  const auto cycle = actual->cycle;
+  EXPECT_EQ(NESBase::Status::BUDGET, actual->RunFrame(262 * 341 - 2));
+  EXPECT_EQ(cycle + 262 * 341 - 2, actual->cycle);
+  EXPECT_EQ(NESBase::Status::BUDGET, actual->RunCycles(1));
+  EXPECT_EQ(NESBase::Status::FRAME, actual->RunFrame());
+}
+
+TYPED_TEST(NESTest, DotsUntil) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto nes = this->Boot(&framebuffer);
+  // The background is kept enabled from the first frame on, so that odd frames skip a dot.
+  nes->RunFrame();
+  for (auto i = 0; i < 16; i++) {
+    const std::int16_t scanline = Utility::RandomByte<0x00, 0xFF>() % 262 - 1;
+    const std::int16_t cycle = Utility::RandomByte<0x00, 0xFF>() + 2;
+    nes->RunCycles(nes->ppu->DotsUntil(scanline, cycle));
+    ASSERT_EQ(scanline, nes->ppu->Scanline());
+    ASSERT_EQ(cycle, nes->ppu->Cycle());
+  }
+}
+
+TYPED_TEST(NESTest, NMI) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto nes = this->Boot(&framebuffer);
+  nes->RunFrame();
+  // Once reset, $0000 turns into the NMI handler counting NMIs up, which is no longer overwritten.
+  const std::vector<Byte> handler = {
+    0xE6, 0xF2,             // $0000: INC $F2
+    0x40                    // $0002: RTI
+  };
+  for (Address offset = 0; offset < handler.size(); offset++) nes->cpu_bus->Write(0x0000 + offset, handler[offset]);
+  nes->cpu_bus->Write(0x0230, 0xEA);
+  nes->cpu_bus->Write(0x0231, 0xEA);
+  nes->RunFrame();
+  EXPECT_EQ(0x00, nes->cpu_bus->Read(0x00F2));
+
+  // NMI fires at every vblank while enabled.
+  nes->ppu_registers->ppuctrl.nmi_enable = true;
+  nes->RunFrame();
+  EXPECT_EQ(0x01, nes->cpu_bus->Read(0x00F2));
+  nes->RunFrame();
+  EXPECT_EQ(0x02, nes->cpu_bus->Read(0x00F2));
+  EXPECT_TRUE(nes->ppu_registers->ppuctrl.nmi_enable);
+
+  // Enabling NMI in the middle of vblank fires it at once, or once OAM DMA is done.
+  nes->ppu_registers->ppuctrl.nmi_enable = false;
+  nes->RunFrame();
+  nes->RunCycles(nes->ppu->DotsUntil(241, 4));
+  ASSERT_TRUE(nes->ppu_registers->ppustatus.vblank_start);
+  EXPECT_EQ(0x02, nes->cpu_bus->Read(0x00F2));
+  nes->cpu_bus->Write(0x2000, 0x80);
+  nes->RunCycles(3 * 600);
+  EXPECT_EQ(0x03, nes->cpu_bus->Read(0x00F2));
+}
+
+TYPED_TEST(NESTest, RunUntil) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto nes = this->Boot(&framebuffer);
+  // Stops right before STA $4014.
+  auto breakpoint = [](const TypeParam& nes) { return nes.cpu->PCRegister() == 0x0239; };
+  EXPECT_EQ(NESBase::Status::BREAKPOINT, nes->RunUntil(breakpoint));
+  EXPECT_EQ(0x0239, nes->cpu->PCRegister());
+  EXPECT_EQ(0x00, nes->cpu->ARegister());
+
+  // The breakpoint is not hit within a budget shorter than the loop.
+  EXPECT_EQ(NESBase::Status::BUDGET, nes->RunUntil(breakpoint, 3));
+  EXPECT_NE(0x0239, nes->cpu->PCRegister());
+}
+
+TYPED_TEST(NESTest, SaveState) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  std::vector<ARGB> restored(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto nes = this->Boot(&framebuffer);
+  auto other = this->Boot(&restored);
+  // Tile 0 and palettes get written to the nametables instead, since writes while rendering may
+  // carry on scrolling over into CHR-ROM, which snapshots take as read-only.
+  nes->cpu_bus->Write(0x020C, 0x20);
+  nes->cpu_bus->Write(0x021D, 0x23);
+  std::vector<Byte> snapshot(nes->StateSize());
+  EXPECT_GT(20u * 1024u, snapshot.size());
+  for (auto chunk = 0; chunk < 8; chunk++) {
+    // Snapshots are taken at random, hence in the middle of instructions, DMA and frames.
+    nes->Run(Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>());
+    nes->SaveState(snapshot.data(), snapshot.size());
+    const std::size_t dots = Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>() + 262 * 341;
+    std::fill(framebuffer.begin(), framebuffer.end(), 0x00);
+    nes->Run(dots);
+    const auto cycle = nes->cycle;
+    const auto pc = nes->cpu->PCRegister();
+    const auto a = nes->cpu->ARegister();
+    const auto expected = framebuffer;
+
+    // Runs the very same way once restored, whether to the same machine or to another one.
+    for (auto* const target : {nes.get(), other.get()}) {
+      auto* const pixels = target == nes.get() ? &framebuffer : &restored;
+      std::fill(pixels->begin(), pixels->end(), 0x00);
+      target->LoadState(snapshot.data(), snapshot.size());
+      target->Run(dots);
+      ASSERT_EQ(cycle, target->cycle);
+      ASSERT_EQ(pc, target->cpu->PCRegister());
+      ASSERT_EQ(a, target->cpu->ARegister());
+      ASSERT_EQ(expected, *pixels);
+    }
+  }
+  EXPECT_THROW(nes->LoadState(snapshot.data(), snapshot.size() - 1), InvalidOperation);
+
+  // The opcode in flight is told by the byte right after the one it is fetched as.
+  NESBase::State idle = NESBase::State();
+  NESBase::State fetched = NESBase::State();
+  fetched.cpu.context.opcode_byte = 0xEA;
+  fetched.cpu.context.opcode = Opcodes::Decode(0xEA);
+  std::vector<Byte> lhs(NESBase::EncodedStateSize()), rhs(NESBase::EncodedStateSize());
+  NESBase::Encode(idle, lhs.data());
+  NESBase::Encode(fetched, rhs.data());
+  const auto engaged = std::mismatch(lhs.begin(), lhs.end(), rhs.begin()).first - lhs.begin() + 1;
+  ASSERT_EQ(0x01, rhs[engaged]);
+  // Snapshots of values the machine never holds are refused, leaving the machine as is.
+  nes->SaveState(snapshot.data(), snapshot.size());
+  snapshot[engaged] = 0x02;
+  EXPECT_THROW(nes->LoadState(snapshot.data(), snapshot.size()), InvalidOperation);
+  NESBase::State state = NESBase::State();
+  nes->Save(&state);
+  state.cpu.context.opcode.reset();
+  state.cpu.num_steps = 1;
+  state.cpu.steps[0] = 0x0000;
+  EXPECT_THROW(nes->Load(state), InvalidOperation);
+}
+
+TYPED_TEST(NESTest, Fork) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  std::vector<ARGB> forked(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto nes = this->Boot(&framebuffer);
+  nes->cpu_bus->Write(0x020C, 0x20);
+  nes->cpu_bus->Write(0x021D, 0x23);
+  nes->Run(Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>());
+  auto fork = nes->Fork();
+  fork->ppu->Framebuffer([&forked](std::int16_t x, std::int16_t y, ARGB argb) {
+    forked[y * PPU::kFrameW + x] = argb;
+  });
+  fork->ppu->SkipOutput(false);
+  auto take = [](TypeParam* const target) {
+    std::vector<Byte> snapshot(target->StateSize());
+    target->SaveState(snapshot.data(), snapshot.size());
+    return snapshot;
+  };
+  ASSERT_EQ(take(nes.get()), take(fork.get()));
+
+  // The cartridge is shared until written, then copied by the machine writing it only.
+  const auto data = [](const MemoryBank& chip) { return chip.Data(); };
+  const auto& chips = *nes->rom->chips;
+  const auto& forked_chips = *fork->rom->chips;
+  EXPECT_EQ(data(*chips.prg_rom), data(*forked_chips.prg_rom));
+  EXPECT_EQ(data(*chips.chr_rom), data(*forked_chips.chr_rom));
+  EXPECT_EQ(data(*chips.prg_ram), data(*forked_chips.prg_ram));
+  EXPECT_EQ(nes->rom->Hash(), fork->rom->Hash());
+  const Byte pattern = nes->ppu_bus->Read(0x0010);
+  fork->ppu_bus->Write(0x0010, ~pattern);
+  fork->cpu_bus->Write(0x6000, 0x5A);
+  EXPECT_NE(data(*chips.chr_rom), data(*forked_chips.chr_rom));
+  EXPECT_NE(data(*chips.prg_ram), data(*forked_chips.prg_ram));
+  EXPECT_EQ(data(*chips.prg_rom), data(*forked_chips.prg_rom));
+  EXPECT_EQ(pattern, nes->ppu_bus->Read(0x0010));
+  EXPECT_EQ(static_cast<Byte>(~pattern), fork->ppu_bus->Read(0x0010));
+  EXPECT_NE(0x5A, nes->cpu_bus->Read(0x6000));
+  fork->ppu_bus->Write(0x0010, pattern);
+  fork->cpu_bus->Write(0x6000, nes->cpu_bus->Read(0x6000));
+
+  // Runs the very same way, even once the machine forked is gone.
+  const std::size_t dots = Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>() + 262 * 341;
+  nes->Run(dots);
+  const auto expected = take(nes.get());
+  const auto pixels = framebuffer;
+  nes.reset();
+  fork->Run(dots);
+  EXPECT_EQ(expected, take(fork.get()));
+  EXPECT_EQ(pixels, forked);
+}
+
+TYPED_TEST(NESTest, ForkWithCHRRAM) {
+  // Donkey Kong with CHR-RAM instead, to which the program writes tile 0 unless patched.
+  std::ifstream ifs(this->donkey_kong_, std::ifstream::binary);
+  std::string image((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  image[5] = 0x00;
+  auto take = [](TypeParam* const target) {
+    std::vector<Byte> snapshot(target->StateSize());
+    target->SaveState(snapshot.data(), snapshot.size());
+    return snapshot;
+  };
+  for (bool parent : {true, false}) {
+    std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+    std::vector<ARGB> expected(PPU::kFrameW * PPU::kFrameH, 0x00);
+    std::istringstream is(image);
+    std::istringstream other_is(image);
+    auto nes = this->Boot(is, &framebuffer);
+    auto other = this->Boot(other_is, &expected);
+    nes->Run(Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>());
+    const auto snapshot = take(nes.get());
+    auto fork = nes->Fork();
+    fork->ppu->Framebuffer([&framebuffer](std::int16_t x, std::int16_t y, ARGB argb) {
+      framebuffer[y * PPU::kFrameW + x] = argb;
+    });
+    fork->ppu->SkipOutput(false);
+    // Loading the state copies CHR-RAM, which the PPU of the machine loaded fetches from then on.
+    auto* const target = parent ? nes.get() : fork.get();
+    target->LoadState(snapshot.data(), snapshot.size());
+    other->LoadState(snapshot.data(), snapshot.size());
+    std::fill(framebuffer.begin(), framebuffer.end(), 0x00);
+    for (auto frame = 0; frame < 4; frame++) {
+      target->RunFrame();
+      other->RunFrame();
+      ASSERT_EQ(take(other.get()), take(target));
+      ASSERT_EQ(expected, framebuffer);
+    }
+  }
+}
+
+TYPED_TEST(NESTest, PowerCycle) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto nes = this->Boot(&framebuffer);
+  std::ifstream ifs(this->donkey_kong_, std::ifstream::binary);
+  const auto cartridge = ROMFactory::NROM(ifs);
+  TypeParam fresh(ROMFactory::NROM(*cartridge));
+  auto take = [](TypeParam* const target) {
+    std::vector<Byte> snapshot(target->StateSize());
+    target->SaveState(snapshot.data(), snapshot.size());
+    return snapshot;
+  };
+  nes->cpu_bus->Write(0x020C, 0x20);
+  nes->cpu_bus->Write(0x021D, 0x23);
+  for (auto i = 0; i < 4; i++) {
+    nes->Run(Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>());
+    nes->cpu_bus->Write(0x6000, Utility::RandomByte<0x01, 0xFF>());
+    // The very same as constructed, whether power-cycled or swapped for the same cartridge.
+    if (i % 2 == 0) nes->PowerCycle();
+    else nes->LoadCartridge(*cartridge);
+    ASSERT_EQ(take(&fresh), take(nes.get()));
+    // Which needs the program patched once again, RAM included.
+    nes->cpu_bus->Write(0x0000, 0x4C);
+    nes->cpu_bus->Write(0x0001, 0x00);
+    nes->cpu_bus->Write(0x0002, 0x02);
+    nes->cpu_bus->Write(0x0003, 0x10);
+    EXPECT_EQ(0x00, nes->cpu_bus->Read(0x0200));
+    nes->Run(262 * 341);
+  }
+
+  // Likewise with the threaded rasterization, whose shadow is brought back too.
+  TypeParam threaded(ROMFactory::NROM(*cartridge), PPU::Rasterization::THREADED);
+  threaded.ppu->Framebuffer([](std::int16_t, std::int16_t, ARGB) {});
+  threaded.RunFrame();
+  threaded.PowerCycle();
+  EXPECT_EQ(take(&fresh), take(&threaded));
+
+  // Cartridges of other layouts are refused.
+  std::ifstream other(this->super_mario_brothers_, std::ifstream::binary);
+  EXPECT_THROW(nes->LoadCartridge(*ROMFactory::NROM(other)), InvalidROM);
+}
+
+TYPED_TEST(NESTest, SoftReset) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto nes = this->Boot(&framebuffer);
+  nes->Run(Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>());
+  const Address reset = nes->cpu_bus->Read(0xFFFC) | (nes->cpu_bus->Read(0xFFFD) << 8);
+  nes->SoftReset();
+  EXPECT_EQ(0x00, nes->ppu_registers->ppuctrl.value);
+  EXPECT_EQ(0x00, nes->ppu_registers->ppumask.value);
+  std::vector<Byte> ram;
+  for (Address address = 0x0000; address < 0x0800; address++) ram.push_back(nes->cpu_bus->Read(address));
+  // Jumps to the reset vector once the instruction in flight completes, RAM left as is.
+  const auto status = nes->RunUntil([reset](const TypeParam& target) { return target.cpu->PCRegister() == reset; }, 64);
+  EXPECT_EQ(NESBase::Status::BREAKPOINT, status);
+  for (Address address = 0x0000; address < 0x0800; address++) ASSERT_EQ(ram[address], nes->cpu_bus->Read(address));
+}
+
+TYPED_TEST(NESTest, Rasterize) {
+  constexpr std::size_t kFrames = 24;
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  std::vector<ARGB> threaded(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto expected = this->Boot(&framebuffer);
+  auto actual = this->Boot(&threaded, PPU::Rasterization::THREADED);
+  for (auto* const nes : {expected.get(), actual.get()}) {
+    nes->cpu_bus->Write(0x020C, 0x20);
+    nes->cpu_bus->Write(0x021D, 0x23);
+  }
+  // The cartridge comes with CHR-ROM zero-padded, hence the one with tiles of some pattern instead,
+  // mirrored as specified.
+  std::ifstream ifs(this->donkey_kong_, std::ifstream::binary);
+  const std::string image((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  auto cartridge = [&image](bool vertical) {
+    std::string bytes = image;
+    for (std::size_t i = 0x10 + 0x4000; i < bytes.size(); i++) bytes[i] = static_cast<char>((i * 0x25) ^ (i >> 3));
+    bytes[6] = static_cast<char>((bytes[6] & ~0x01) | (vertical ? 0x01 : 0x00));
+    std::istringstream iss(bytes);
+    return ROMFactory::NROM(iss);
+  };
+  // Carries the program over, since RAM gets cleared, jumped to at reset once again. Tiles in the
+  // second nametable are shown or hidden as mirrored, in colours of their own.
+  auto insert = [](TypeParam* const nes, const ROM& cartridge) {
+    std::vector<Byte> ram;
+    for (Address address = 0x0000; address < 0x0800; address++) ram.push_back(nes->cpu_bus->Read(address));
+    nes->LoadCartridge(cartridge);
+    for (Address address = 0x0000; address < 0x0800; address++) nes->cpu_bus->Write(address, ram[address]);
+    nes->cpu_bus->Write(0x0000, 0x4C);
+    nes->cpu_bus->Write(0x0001, 0x00);
+    nes->cpu_bus->Write(0x0002, 0x02);
+    nes->cpu_bus->Write(0x2006, 0x24);
+    nes->cpu_bus->Write(0x2006, 0x00);
+    for (Address address = 0x2400; address < 0x27C0; address++) nes->cpu_bus->Write(0x2007, static_cast<Byte>(address));
+    nes->cpu_bus->Write(0x2006, 0x3F);
+    nes->cpu_bus->Write(0x2006, 0x00);
+    for (Byte entry = 0x00; entry < 0x20; entry++) nes->cpu_bus->Write(0x2007, entry + 0x10);
+  };
+  // Pixels of the threaded rasterization arrive a frame late, i.e., along with the next frame.
+  auto compare = [&]() {
+    expected->RunFrame();
+    actual->RunFrame();
+    for (std::size_t frame = 0; frame < kFrames; frame++) {
+      const auto previous = framebuffer;
+      expected->RunFrame();
+      actual->RunFrame();
+      ASSERT_EQ(previous, threaded) << "Frame " << frame;
+    }
+  };
+  for (bool vertical : {false, true}) {
+    const auto inserted = cartridge(vertical);
+    for (auto* const nes : {expected.get(), actual.get()}) insert(nes, *inserted);
+    compare();
+  }
+}
+
+TYPED_TEST(NESTest, RunFrameAhead) {
+  constexpr std::size_t kAhead = 2;
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  std::vector<ARGB> ahead(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto expected = this->Boot(&framebuffer);
+  auto actual = this->Boot(&ahead);
+  for (auto* const nes : {expected.get(), actual.get()}) {
+    nes->cpu_bus->Write(0x020C, 0x20);
+    nes->cpu_bus->Write(0x021D, 0x23);
+  }
+  std::vector<std::vector<ARGB>> frames;
+  std::vector<std::size_t> cycles;
+  for (std::size_t frame = 0; frame < 8 + kAhead; frame++) {
+    expected->RunFrame();
+    frames.push_back(framebuffer);
+    cycles.push_back(expected->cycle);
+  }
+  // Presents the frame the specified number of frames ahead, while advancing a single frame.
+  for (std::size_t frame = 0; frame < 8; frame++) {
+    ASSERT_EQ(NESBase::Status::FRAME, actual->RunFrameAhead(kAhead));
+    ASSERT_EQ(cycles[frame], actual->cycle);
+    ASSERT_EQ(frames[frame + kAhead], ahead);
+    ASSERT_FALSE(actual->ppu->IsSkippingOutput());
+  }
+
+  std::ifstream ifs(this->donkey_kong_, std::ifstream::binary);
+  TypeParam threaded(ROMFactory::NROM(ifs), PPU::Rasterization::THREADED);
+  EXPECT_THROW(threaded.RunFrameAhead(kAhead), InvalidOperation);
+}
+
+TYPED_TEST(NESTest, Speculate) {
+  std::vector<ARGB> framebuffer(PPU::kFrameW * PPU::kFrameH, 0x00);
+  std::vector<ARGB> speculated(PPU::kFrameW * PPU::kFrameH, 0x00);
+  auto expected = this->Boot(&framebuffer);
+  auto actual = this->Boot(&speculated);
+  auto take = [](TypeParam* const target) {
+    std::vector<Byte> snapshot(target->StateSize());
+    target->SaveState(snapshot.data(), snapshot.size());
+    return snapshot;
+  };
+  for (auto* const nes : {expected.get(), actual.get()}) {
+    nes->cpu_bus->Write(0x020C, 0x20);
+    nes->cpu_bus->Write(0x021D, 0x23);
+  }
+  actual->Speculate(true);
+  ASSERT_TRUE(actual->IsSpeculating());
+  // Runs the very same way as serially, whether stopped on frames or anywhere in between.
+  for (auto i = 0; i < 4; i++) {
+    const std::size_t dots = Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>();
+    expected->Run(dots);
+    actual->Run(dots);
+    ASSERT_EQ(take(expected.get()), take(actual.get()));
+    expected->RunFrame();
+    actual->RunFrame();
+    ASSERT_EQ(take(expected.get()), take(actual.get()));
+    ASSERT_EQ(framebuffer, speculated);
+  }
+  EXPECT_LT(0u, actual->Speculation().writes);
+  EXPECT_LT(0u, actual->Speculation().synchronizations);
+  EXPECT_EQ(0u, actual->Speculation().rollbacks);
+
+  // Enabling NMI over and over in the middle of vblank rolls back every time, firing NMI at once.
+  const std::vector<Byte> handler = {
+    0xE6, 0xF2,             // $0000: INC $F2
+    0x40                    // $0002: RTI
+  };
+  const std::vector<Byte> program = {
+    0xA9, 0x00,             // $0300: LDA #$00
+    0x8D, 0x00, 0x20,       // $0302: STA $2000
+    0xA9, 0x80,             // $0305: LDA #$80
+    0x8D, 0x00, 0x20,       // $0307: STA $2000
+    0x4C, 0x00, 0x03        // $030A: JMP $0300
+  };
+  for (auto* const nes : {expected.get(), actual.get()}) {
+    for (Address offset = 0; offset < handler.size(); offset++) nes->cpu_bus->Write(0x0000 + offset, handler[offset]);
+    for (Address offset = 0; offset < program.size(); offset++) nes->cpu_bus->Write(0x0300 + offset, program[offset]);
+    nes->cpu_bus->Write(0x0230, 0xEA);
+    nes->cpu_bus->Write(0x0231, 0xEA);
+    nes->cpu_bus->Write(0x0243, 0x03);
+  }
+  for (auto i = 0; i < 3; i++) {
+    expected->RunFrame();
+    actual->RunFrame();
+    ASSERT_EQ(take(expected.get()), take(actual.get()));
+  }
+  EXPECT_LT(0x01, actual->cpu_bus->Read(0x00F2));
+  EXPECT_LT(0u, actual->Speculation().rollbacks);
+  EXPECT_GE(actual->Speculation().synchronizations, actual->Speculation().conflicts);
+
+  // Goes on serially once stopped.
+  actual->Speculate(false);
+  EXPECT_FALSE(actual->IsSpeculating());
+  expected->RunFrame();
+  actual->RunFrame();
+  EXPECT_EQ(take(expected.get()), take(actual.get()));
+
+  std::ifstream ifs(this->donkey_kong_, std::ifstream::binary);
+  TypeParam threaded(ROMFactory::NROM(ifs), PPU::Rasterization::THREADED);
+  EXPECT_THROW(threaded.Speculate(true), InvalidOperation);
+}
+
+}  // namespace core
+}  // namespace nesdev
@@ -0,0 +1,92 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <memory>
+#include <string>
+#include <vector>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nesdev/core.h>
+#include "utils.h"
+
+namespace nesdev {
+namespace core {
+
+class NetplayTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Utility::Init();
+  }
+
+  /*
+   * Buttons held for a few frames each, so that predictions fail every now and then.
+   */
+  std::vector<Byte> Input(std::size_t frames) {
+    std::vector<Byte> input;
+    while (input.size() < frames) input.resize(input.size() + Utility::RandomByte<1, 12>(), Utility::RandomByte<0x00, 0xFF>());
+    input.resize(frames);
+    return input;
+  }
+
+  std::string super_mario_brothers_ = "core/tests/data/super_mario_brothers.nes";
+};
+
+TEST_F(NetplayTest, Rollback) {
+  constexpr std::size_t kFrames = 90;
+  for (std::size_t delay : {0, 3, 12}) {
+    const std::vector<std::vector<Byte>> input = {Input(kFrames), Input(kFrames)};
+    Loopback loopback(delay);
+    std::vector<std::unique_ptr<NES>> nes;
+    std::vector<Rollback> sessions;
+    for (std::size_t player = 0; player < 2; player++) {
+      nes.push_back(Utility::Boot(super_mario_brothers_));
+      sessions.emplace_back(loopback.End(player), player, 8);
+    }
+    while (sessions[0].Frames() < kFrames || sessions[1].Frames() < kFrames) {
+      for (std::size_t player = 0; player < 2; player++) {
+        const auto frame = sessions[player].Frames();
+        if (frame < kFrames) sessions[player].RunFrame(nes[player].get(), input[player][frame]);
+      }
+      loopback.Tick();
+    }
+    // Once all the input arrives, both sides end up as if played on a single machine.
+    while (sessions[0].Confirmed() < kFrames || sessions[1].Confirmed() < kFrames) {
+      for (std::size_t player = 0; player < 2; player++) sessions[player].Synchronize(nes[player].get());
+      loopback.Tick();
+    }
+    auto expected = Utility::Boot(super_mario_brothers_);
+    for (std::size_t frame = 0; frame < kFrames; frame++) {
+      expected->controller_1->Buttons(input[0][frame]);
+      expected->controller_2->Buttons(input[1][frame]);
+      expected->RunFrame();
+    }
+    EXPECT_EQ(Utility::Take(expected.get()), Utility::Take(nes[0].get()));
+    EXPECT_EQ(Utility::Take(expected.get()), Utility::Take(nes[1].get()));
+    for (const auto& session : sessions) {
+      if (delay > 0) {
+        EXPECT_LT(0u, session.Rollbacks());
+        EXPECT_LE(session.Rollbacks(), session.Resimulated());
+      }
+      if (delay > 8) EXPECT_LT(0u, session.Stalls());
+      else EXPECT_EQ(0u, session.Stalls());
+    }
+  }
+}
+
+TEST_F(NetplayTest, Refuse) {
+  Loopback loopback;
+  EXPECT_THROW(static_cast<void>(loopback.End(2)), InvalidOperation);
+  EXPECT_THROW(Rollback(loopback.End(0), 2), InvalidOperation);
+  EXPECT_THROW(Rollback(loopback.End(0), 0, 0), InvalidOperation);
+  // Input out of order.
+  auto nes = Utility::Boot(super_mario_brothers_);
+  Rollback rollback(loopback.End(0), 0);
+  loopback.End(1)->Send({1, 0x00});
+  EXPECT_THROW(rollback.Synchronize(nes.get()), InvalidOperation);
+}
+
+}  // namespace core
+}  // namespace nesdev
@@ -5,6 +5,7 @@
  * Trademarks are owned by their respect owners.
  */
 #include <cstring>
+#include <fstream>
 #include <memory>
 #include <vector>
 #include <gmock/gmock.h>
@@ -43,6 +44,8 @@ class PPUTest : public testing::Test {
   PPU::ObjectAttributeMap<64> oam_;
 
   PPU::ObjectAttributeMap<>::Entry entry_;
+
+  std::string donkey_kong_ = "core/tests/data/donkey_kong.nes";
 };
 
 TEST_F(PPUTest, Context) {
@@ -123,6 +126,74 @@ TEST_F(PPUTest, ObjectAttributeMapData) {
   EXPECT_EQ(x, entry_.x);
 }
 
+TEST_F(PPUTest, ObjectAttributeMapCollisionsAt) {
+  for (auto i = 0; i < PPU::kFrameH; i++) {
+    EXPECT_EQ(i <  8 ? ~0ull : 0ull, oam_.CollisionsAt(i, true));
+    EXPECT_EQ(i < 16 ? ~0ull : 0ull, oam_.CollisionsAt(i, false));
+  }
+
+  for (auto i = 0x0000u; i <= 0x00FFu; i += 4) {
+    oam_.Write(i, 0xFF);
+  }
+  for (auto i = 0; i < PPU::kFrameH; i++) {
+    EXPECT_EQ(0ull, oam_.CollisionsAt(i, true));
+    EXPECT_EQ(0ull, oam_.CollisionsAt(i, false));
+  }
+
+  auto y = Utility::RandomByte<0x00, 0xDF>();
+  oam_.Write(4 * 3 + 0, y);
+  oam_.Write(4 * 3 + 1, Utility::RandomByte<0x00, 0xFF>());
+  oam_.Write(4 * 3 + 2, Utility::RandomByte<0x00, 0xFF>());
+  oam_.Write(4 * 3 + 3, Utility::RandomByte<0x00, 0xFF>());
+  for (auto i = 0; i < PPU::kFrameH; i++) {
+    EXPECT_EQ(i - y >= 0 && i - y <  8 ? 1ull << 3 : 0ull, oam_.CollisionsAt(i, true));
+    EXPECT_EQ(i - y >= 0 && i - y < 16 ? 1ull << 3 : 0ull, oam_.CollisionsAt(i, false));
+  }
+
+  oam_.Write(4 * 3 + 0, 0xEF);
+  for (auto i = 0; i < PPU::kFrameH; i++) {
+    EXPECT_EQ(i >= 0xEF ? 1ull << 3 : 0ull, oam_.CollisionsAt(i, true));
+    EXPECT_EQ(i >= 0xEF ? 1ull << 3 : 0ull, oam_.CollisionsAt(i, false));
+  }
+}
+
+TEST_F(PPUTest, NametablesMirror) {
+  std::ifstream ifs(donkey_kong_, std::ifstream::binary);
+  auto rom = ROMFactory::NROM(ifs);
+  ifs.close();
+  PPU::Nametables<0x2000, 0x3EFF> nametables(0x0400, rom.get());
+
+  auto check = [&nametables](std::array<int, 4> layout) {
+    for (auto i = 0; i < 4; i++) {
+      auto byte = Utility::RandomByte<0x00, 0xFF>();
+      auto offset = Utility::RandomAddress<0x0000, 0x03FF>();
+      nametables.Write(0x2000 + 0x0400 * i + offset, byte);
+      for (auto j = 0; j < 4; j++) {
+        if (layout[i] != layout[j]) continue;
+        EXPECT_EQ(byte, nametables.Read(0x2000 + 0x0400 * j + offset));
+        EXPECT_EQ(byte, nametables.PageAt(0x2000 + 0x0400 * j)[offset]);
+        if (j < 3) {
+          EXPECT_EQ(byte, nametables.Read(0x3000 + 0x0400 * j + offset));
+        }
+      }
+    }
+  };
+
+  check({0, 0, 1, 1});
+  nametables.Mirror(ROM::Header::Mirroring::VERTICAL);
+  check({0, 1, 0, 1});
+  nametables.Mirror(ROM::Header::Mirroring::ONESCREEN_LO);
+  check({0, 0, 0, 0});
+  nametables.Mirror(ROM::Header::Mirroring::ONESCREEN_HI);
+  check({1, 1, 1, 1});
+  nametables.Mirror(ROM::Header::Mirroring::FOURSCREEN);
+  check({0, 1, 2, 3});
+  EXPECT_THROW(nametables.Mirror(ROM::Header::Mirroring::HARDWARE), InvalidROM);
+
+  rom->mapper->MirroringChanged();
+  check({0, 0, 1, 1});
+}
+
 TEST_F(PPUTest, ShifterAssignment) {
   auto x = Utility::RandomByte<0x00, 0xFF>();
   shifter_.shift(x);
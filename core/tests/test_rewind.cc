@@ -0,0 +1,85 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <memory>
+#include <string>
+#include <vector>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nesdev/core.h>
+#include "utils.h"
+
+namespace nesdev {
+namespace core {
+
+class RewindTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Utility::Init();
+    nes_ = Utility::Boot(donkey_kong_);
+  }
+
+  /*
+   * Runs the specified number of frames, capturing each, and returns the snapshots captured.
+   */
+  std::vector<std::vector<Byte>> Run(Rewind* const rewind, std::size_t frames, std::size_t interval) {
+    std::vector<std::vector<Byte>> captured;
+    for (std::size_t frame = 0; frame < frames; frame++) {
+      if (frame % interval == 0) captured.push_back(Utility::Take(nes_.get()));
+      rewind->Capture(nes_.get());
+      nes_->RunFrame();
+    }
+    return captured;
+  }
+
+  std::unique_ptr<NES> nes_;
+
+  std::string donkey_kong_ = "core/tests/data/donkey_kong.nes";
+};
+
+TEST_F(RewindTest, Step) {
+  Rewind rewind(1 << 20, 2, 5);
+  auto history = Run(&rewind, 40, 2);
+  EXPECT_EQ(20u, rewind.Count());
+  // Goes back across keyframes, then forth again from the middle of the history.
+  for (auto i = 0; i < 7; i++) {
+    ASSERT_TRUE(rewind.Step(nes_.get()));
+    ASSERT_EQ(history.back(), Utility::Take(nes_.get()));
+    history.pop_back();
+  }
+  for (const auto& snapshot : Run(&rewind, 10, 2)) history.push_back(snapshot);
+  while (!history.empty()) {
+    ASSERT_TRUE(rewind.Step(nes_.get()));
+    ASSERT_EQ(history.back(), Utility::Take(nes_.get()));
+    history.pop_back();
+  }
+  EXPECT_FALSE(rewind.Step(nes_.get()));
+  EXPECT_EQ(0u, rewind.Usage());
+}
+
+TEST_F(RewindTest, Budget) {
+  constexpr std::size_t kBudget = 0x2000;
+  Rewind rewind(kBudget, 1, 8);
+  auto history = Run(&rewind, 300, 1);
+  EXPECT_GE(kBudget, rewind.Usage());
+  EXPECT_LT(8u, rewind.Count());
+  EXPECT_GT(history.size(), rewind.Count());
+  // The snapshots kept are the latest ones, starting with a keyframe.
+  const std::size_t count = rewind.Count();
+  for (std::size_t i = 0; i < count; i++) {
+    ASSERT_TRUE(rewind.Step(nes_.get()));
+    ASSERT_EQ(history[history.size() - 1 - i], Utility::Take(nes_.get()));
+  }
+  EXPECT_FALSE(rewind.Step(nes_.get()));
+}
+
+TEST_F(RewindTest, InvalidInterval) {
+  EXPECT_THROW(Rewind(1 << 20, 0, 1), InvalidOperation);
+  EXPECT_THROW(Rewind(1 << 20, 1, 0), InvalidOperation);
+}
+
+}  // namespace core
+}  // namespace nesdev
@@ -141,5 +141,15 @@ TEST_F(ROMTest, Zelda) {
   EXPECT_EQ(1 * 8192u,  header_.SizeOfCHRRam());
 }
 
+TEST_F(ROMTest, FourScreen) {
+  ifs_.open(donkey_kong_, std::ifstream::binary);
+  ifs_.read(reinterpret_cast<char*>(&header_), sizeof(ROM::Header));
+  ifs_.close();
+
+  header_.flags6_.ignore_mirroring = true;
+  EXPECT_TRUE(header_.IgnoreMirroing());
+  EXPECT_EQ(ROM::Header::Mirroring::FOURSCREEN, header_.Mirroring());
+}
+
 }  // namespace core
 }  // namespace nesdev
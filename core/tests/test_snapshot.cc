@@ -0,0 +1,105 @@
+/*
+ * NesDev:
+ * Emulator for the Nintendo Entertainment System (R) Archetecture.
+ * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
+ * Trademarks are owned by their respect owners.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nesdev/core.h>
+#include "utils.h"
+
+namespace nesdev {
+namespace core {
+
+class SnapshotTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Utility::Init();
+  }
+
+  std::string Slurp(const std::string& path) {
+    std::ifstream ifs(path, std::ifstream::binary);
+    return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  }
+
+  std::string donkey_kong_ = "core/tests/data/donkey_kong.nes";
+
+  std::string super_mario_brothers_ = "core/tests/data/super_mario_brothers.nes";
+};
+
+TEST_F(SnapshotTest, Compress) {
+  for (std::size_t size : {0, 1, 4, 15, 16, 300, 0x10000, 0x12345}) {
+    std::vector<Byte> data(size, 0x00);
+    // Runs of zeros, repetitions and noise, so as to go through the extended lengths.
+    for (std::size_t i = 0; i < size; i++) {
+      if (i % 1000 < 300)      data[i] = Utility::RandomByte<0x00, 0xFF>();
+      else if (i % 1000 < 600) data[i] = static_cast<Byte>(i % 7);
+    }
+    std::vector<Byte> compressed;
+    const std::size_t compressed_size = Snapshot::Compress(data.data(), data.size(), &compressed);
+    EXPECT_EQ(compressed.size(), compressed_size);
+    std::istringstream is(std::string(compressed.begin(), compressed.end()));
+    std::vector<Byte> decompressed(size, 0xFF);
+    Snapshot::Decompress(is, compressed.size(), decompressed.data(), decompressed.size());
+    EXPECT_EQ(data, decompressed);
+    std::fill(decompressed.begin(), decompressed.end(), 0xFF);
+    Snapshot::Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+    EXPECT_EQ(data, decompressed);
+    if (size == 0x10000) {
+      EXPECT_GT(size / 2, compressed_size);
+    }
+    if (size > 0) {
+      std::istringstream truncated(std::string(compressed.begin(), compressed.end() - 1));
+      EXPECT_THROW(Snapshot::Decompress(truncated, compressed.size() - 1, decompressed.data(), decompressed.size()), InvalidOperation);
+    }
+  }
+}
+
+TEST_F(SnapshotTest, WriteAndLoad) {
+  const std::string path = testing::TempDir() + "nesdev_snapshot_test.ness";
+  auto nes = Utility::Boot(donkey_kong_);
+  std::vector<std::vector<Byte>> expected;
+  {
+    SnapshotWriter writer;
+    for (auto i = 0; i < 4; i++) {
+      nes->Run(Utility::RandomByte<0x01, 0xFF>() * Utility::RandomByte<0x01, 0xFF>() * 16);
+      writer.Write(path + std::to_string(i), nes.get());
+      expected.push_back(Utility::Take(nes.get()));
+    }
+    writer.Flush();
+  }
+  for (auto i = 0; i < 4; i++) {
+    const std::string file = Slurp(path + std::to_string(i));
+    EXPECT_GT(expected[i].size(), file.size());
+    auto other = Utility::Boot(donkey_kong_);
+    std::istringstream is(file);
+    Snapshot::Load(is, other.get());
+    EXPECT_EQ(expected[i], Utility::Take(other.get()));
+  }
+
+  const std::string file = Slurp(path + "0");
+  // Snapshots of other cartridges, other versions or truncated ones are refused.
+  auto other = Utility::Boot(super_mario_brothers_);
+  std::istringstream another_cartridge(file);
+  EXPECT_THROW(Snapshot::Load(another_cartridge, other.get()), InvalidOperation);
+  std::string another_version = file;
+  another_version[4]++;
+  std::istringstream another_version_is(another_version);
+  EXPECT_THROW(Snapshot::Load(another_version_is, nes.get()), InvalidOperation);
+  std::istringstream truncated(file.substr(0, file.size() - 1));
+  EXPECT_THROW(Snapshot::Load(truncated, nes.get()), InvalidOperation);
+
+  for (auto i = 0; i < 4; i++) std::remove((path + std::to_string(i)).c_str());
+}
+
+}  // namespace core
+}  // namespace nesdev
@@ -82,14 +82,17 @@ void Backend::Update() {
 
   SDL_RenderClear(renderer_);
   HandleEvents();
-  std::swap(b_buffer_, f_buffer_);
 
   if (delay < Backend::kDelay)
     usleep(static_cast<std::uint32_t>(Backend::kDelay - delay));
 
-  if (SDL_UpdateTexture(texture_, 0, f_buffer_, nc::PPU::kFrameW * sizeof(Uint32))) {
-    std::stringstream ss("failed to update screen texture: "); ss << SDL_GetError();
-    throw std::runtime_error(ss.str());
+  // The PPU writes nothing for unchanged frames, so the back buffer has to keep the last frame.
+  if (!nes_.ppu->IsFrameUnchanged()) {
+    std::copy(b_buffer_, b_buffer_ + nc::PPU::kFrameW * nc::PPU::kFrameH, f_buffer_);
+    if (SDL_UpdateTexture(texture_, 0, f_buffer_, nc::PPU::kFrameW * sizeof(Uint32))) {
+      std::stringstream ss("failed to update screen texture: "); ss << SDL_GetError();
+      throw std::runtime_error(ss.str());
+    }
   }
 
   if (SDL_RenderCopy(renderer_, texture_, 0, 0)) {
@@ -4,6 +4,7 @@
  * Written by and Copyright (C) 2020 Shingo OKAWA shingo.okawa.g.h.c@gmail.com
  * Trademarks are owned by their respect owners.
  */
+#include <cstddef>
 #include <filesystem>
 #include <fstream>
 #include <functional>
@@ -47,10 +48,11 @@ int main(int argc, char** argv) {
 	sdl.Update();
       }
     } else {
+      // Hides the latency between input polling and the controller latch, at the cost of frames.
+      const std::size_t ahead = cli.Defined("--run_ahead") ? std::stoul(cli.Get("--run_ahead")) : 0;
       while (sdl.IsRunning()) {
-	nes.Tick();
-	if (nes.ppu->IsPostRenderLine() && nes.ppu->Cycle() == 0)
-	  sdl.Update();
+	nes.RunFrameAhead(ahead);
+	sdl.Update();
       }
     }
   } catch (std::exception& e) {
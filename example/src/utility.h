@@ -17,6 +17,7 @@
 #include <queue>
 #include <deque>
 #include <string>
+#include <vector>
 #include <nesdev/core.h>
 #include "backend.h"
 
@@ -176,30 +177,15 @@ class Utility {
 # define B(x) ((x) & 0x000000FF)
 
   static void RenderCHRRom(const nc::NES& nes, Backend& sdl) {
+    std::vector<nc::ARGB> pixels(nc::PPU::kPatternTableW * nc::PPU::kPatternTableH);
     for (auto h = 0; h < NUM_PTTR_TABLES; h++) {
-      for (auto i = 0; i < PTTR_TILE_COUNT; i++) {
-        for (auto j = 0; j < TILE_PIXEL_H; j++) {
-	  nes.ppu->Write(0x2006, ((h * PTTR_BYTE_COUNT + i * TILE_BYTE_COUNT + j) & 0xFF00) >> 8);
-	  nes.ppu->Write(0x2006, ((h * PTTR_BYTE_COUNT + i * TILE_BYTE_COUNT + j) & 0x00FF) >> 0);
-	  nes.ppu->Read(0x2007); // Data deffered
-	  nc::Byte lsb = nes.ppu->Read(0x2007);
-
-	  nes.ppu->Write(0x2006, ((h * PTTR_BYTE_COUNT + i * TILE_BYTE_COUNT + j + TILE_BYTE_COUNT / 2) & 0xFF00) >> 8);
-	  nes.ppu->Write(0x2006, ((h * PTTR_BYTE_COUNT + i * TILE_BYTE_COUNT + j + TILE_BYTE_COUNT / 2) & 0x00FF) >> 0);
-	  nes.ppu->Read(0x2007); // Data deffered
-	  nc::Byte msb = nes.ppu->Read(0x2007);
-
-	  for (auto k = 0; k < TILE_PIXEL_W; k++) {
-	    std::int16_t x = h * PTTR_DISP_W + (i % TILE_BYTE_COUNT) * TILE_PIXEL_W + k;
-	    std::int16_t y = (i / TILE_BYTE_COUNT) * TILE_PIXEL_H + j;
-
-            nc::ARGB argb = nes.ppu->Colour(
-	      nes.ppu_registers->ppumask.intensity,
-	      ((1 & 0x3) << 2) | (TILE_INDEX(msb, k) << 1) | TILE_INDEX(lsb, k));
-	    nc::Byte grey = 0.2126f * R(argb) + 0.7152f * G(argb) + 0.0722f * B(argb);
-	    sdl.Pixel(x, y, grey << 16 | grey << 8 | grey);
-	  }
-	}
+      nes.ppu->RenderPatternTable(h, 1, pixels.data());
+      for (std::int16_t y = 0; y < nc::PPU::kPatternTableH; y++) {
+        for (std::int16_t x = 0; x < nc::PPU::kPatternTableW; x++) {
+          nc::ARGB argb = pixels[y * nc::PPU::kPatternTableW + x];
+          nc::Byte grey = 0.2126f * R(argb) + 0.7152f * G(argb) + 0.0722f * B(argb);
+          sdl.Pixel(h * PTTR_DISP_W + x, y, grey << 16 | grey << 8 | grey);
+        }
       }
     }
   }